@@ -33,6 +33,8 @@ struct {
   struct buf head;
 } bcache;
 
+int nvalid;  // 缓存了有效数据的buf数，供sysinfo使用
+
 void
 binit(void)
 {
@@ -78,6 +80,8 @@ bget(uint dev, uint blockno)
     if(b->refcnt == 0) {
       b->dev = dev;
       b->blockno = blockno;
+      if(b->valid)
+        __sync_fetch_and_sub(&nvalid, 1);
       b->valid = 0;
       b->refcnt = 1;
       release(&bcache.lock);
@@ -98,6 +102,7 @@ bread(uint dev, uint blockno)
   if(!b->valid) {
     virtio_disk_rw(b, 0);
     b->valid = 1;
+    __sync_fetch_and_add(&nvalid, 1);
   }
   return b;
 }
@@ -150,4 +155,9 @@ bunpin(struct buf *b) {
   release(&bcache.lock);
 }
 
-
+// Number of buffers holding valid block contents.
+int
+bcount(void)
+{
+  return nvalid;
+}
@@ -16,6 +16,7 @@ void            brelse(struct buf*);
 void            bwrite(struct buf*);
 void            bpin(struct buf*);
 void            bunpin(struct buf*);
+int             bcount(void);
 
 // console.c
 void            consoleinit(void);
@@ -64,6 +65,7 @@ void*           kalloc(void);
 void            kfree(void *);
 void            kinit(void);
 uint64          kcount(void);
+void            kcpucount(int*, int*);
 
 // log.c
 void            initlog(int, struct superblock*);
@@ -86,6 +88,8 @@ void            printfinit(void);
 int             cpuid(void);
 void            exit(int);
 int             fork(void);
+int             vfork(void);
+void            vforkrelease(struct proc*, pagetable_t, uint64);
 int             growproc(int);
 void            proc_mapstacks(pagetable_t);
 pagetable_t     proc_pagetable(struct proc *);
@@ -106,6 +110,8 @@ int             either_copyout(int user_dst, uint64 dst, void *src, uint64 len);
 int             either_copyin(void *dst, int user_src, uint64 src, uint64 len);
 void            procdump(void);
 int             procnum(void);
+void            calcload(void);
+extern uint64   loadavg[3];
 
 // swtch.S
 void            swtch(struct context*, struct context*);
@@ -114,6 +114,11 @@ exec(char *path, char **argv)
   p->sz = sz;
   p->trapframe->epc = elf.entry;  // initial program counter = main
   p->trapframe->sp = sp; // initial stack pointer
+  if(p->vforkparent){
+    // 旧的用户内存是借父进程的，还回去而不是释放
+    vforkrelease(p, oldpagetable, oldsz);
+    oldsz = 0;
+  }
   proc_freepagetable(oldpagetable, oldsz);
 
   return argc; // this ends up in a0, the first argument to main(argc, argv)
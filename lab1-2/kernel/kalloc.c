@@ -23,6 +23,13 @@ struct {
   struct run *freelist;//对空闲空间管理的链表
 } kmem;
 
+// 每个CPU各自累计的页计数，sysinfo求和即可，不必遍历空闲链表。
+// 只在持有kmem.lock（已关中断）时更新，所以cpuid()不会变。
+struct {
+  int nfree;    // 在该CPU上释放的页数减去分配的页数，求和即为空闲页数
+  int nalloc;   // 在该CPU上分配出去的页数
+} kstat[NCPU];
+
 void
 kinit()
 {
@@ -59,6 +66,7 @@ kfree(void *pa)
   acquire(&kmem.lock);
   r->next = kmem.freelist;
   kmem.freelist = r;
+  kstat[cpuid()].nfree++;
   release(&kmem.lock);
 }
 
@@ -72,8 +80,11 @@ kalloc(void)
 
   acquire(&kmem.lock);
   r = kmem.freelist;
-  if(r)
+  if(r){
     kmem.freelist = r->next;
+    kstat[cpuid()].nfree--;
+    kstat[cpuid()].nalloc++;
+  }
   release(&kmem.lock);
 
   if(r)
@@ -84,15 +95,19 @@ kalloc(void)
 uint64
 kcount(void)
 {
-  struct run *p = kmem.freelist;
-  uint64 count = 0;
-  //对内存计数的时候先上锁防止其他进程对内存写东西
-  acquire(&kmem.lock);
-  while(p){
-    count++;
-    p=p->next;//对空闲内存的管理是按照链表形式管理的
+  int count = 0;
+  //各CPU的计数之和就是空闲页数，常数时间
+  for(int i = 0; i < NCPU; i++)
+    count += kstat[i].nfree;
+  return (uint64)count*PGSIZE;
+}
+
+// 把每个CPU的计数拷贝到两个长度为NCPU的数组中
+void
+kcpucount(int *nfree, int *nalloc)
+{
+  for(int i = 0; i < NCPU; i++){
+    nfree[i] = kstat[i].nfree;
+    nalloc[i] = kstat[i].nalloc;
   }
-  release(&kmem.lock);
-  //最后只需要返回空闲页表个数再与页表size相乘即可
-  return count*PGSIZE;
-}
\ No newline at end of file
+}
@@ -5,6 +5,7 @@
 #include "spinlock.h"
 #include "proc.h"
 #include "defs.h"
+#include "sysinfo.h"
 
 struct cpu cpus[NCPU];
 
@@ -20,12 +21,24 @@ static void freeproc(struct proc *p);
 
 extern char trampoline[]; // trampoline.S
 
+// 每个CPU上创建的进程数减去回收的进程数，求和即为进程总数。
+// 只在持有p->lock（已关中断）时更新。
+int nproc_cpu[NCPU];
+
+// load average，定点数，小数部分SI_LOAD_SHIFT位
+#define FIXED_1 (1<<SI_LOAD_SHIFT)
+static uint64 loadexp[3] = {1884, 2014, 2037};  // FIXED_1/exp(5s/1min), 5min, 15min
+uint64 loadavg[3];
+
 // helps ensure that wakeups of wait()ing
 // parents are not lost. helps obey the
 // memory model when using p->parent.
 // must be acquired before any p->lock.
 struct spinlock wait_lock;
 
+// 根页表中只映射用户内存的项数，最后一项映射trampoline和trapframe
+#define NUSERPDE PX(2, TRAPFRAME)
+
 // Allocate a page for each process's kernel stack.
 // Map it high in memory, followed by an invalid
 // guard page.
@@ -119,6 +132,7 @@ allocproc(void)
 found:
   p->pid = allocpid();
   p->state = USED;
+  nproc_cpu[cpuid()]++;
 
   // Allocate a trapframe page.
   if((p->trapframe = (struct trapframe *)kalloc()) == 0){
@@ -163,6 +177,8 @@ freeproc(struct proc *p)
   p->chan = 0;
   p->killed = 0;
   p->xstate = 0;
+  if(p->state != UNUSED)
+    nproc_cpu[cpuid()]--;
   p->state = UNUSED;
 }
 
@@ -330,6 +346,81 @@ fork(void)
   return pid;
 }
 
+// Like fork(), but the child borrows the parent's user memory
+// instead of copying it: the user part of its root page table
+// points at the parent's lower-level page tables. The parent
+// sleeps until the child gives the memory back in exec() or
+// exit(), so the child must do little more than call those.
+int
+vfork(void)
+{
+  int i, pid;
+  struct proc *np;
+  struct proc *p = myproc();
+
+  if((np = allocproc()) == 0){
+    return -1;
+  }
+
+  // 根页表中映射用户内存的项直接抄父进程的，不复制任何页
+  for(i = 0; i < NUSERPDE; i++)
+    np->pagetable[i] = p->pagetable[i];
+  np->sz = p->sz;
+  np->vforkparent = p;
+
+  *(np->trapframe) = *(p->trapframe);
+  np->trapframe->a0 = 0;
+
+  for(i = 0; i < NOFILE; i++)
+    if(p->ofile[i])
+      np->ofile[i] = filedup(p->ofile[i]);
+  np->cwd = idup(p->cwd);
+
+  safestrcpy(np->name, p->name, sizeof(p->name));
+  np->trace_mask = p->trace_mask;
+
+  pid = np->pid;
+
+  release(&np->lock);
+
+  acquire(&wait_lock);
+  np->parent = p;
+  release(&wait_lock);
+
+  acquire(&np->lock);
+  np->state = RUNNABLE;
+  release(&np->lock);
+
+  // 子进程在exec或exit之前一直在用我们的内存
+  acquire(&wait_lock);
+  while(np->vforkparent == p)
+    sleep(np, &wait_lock);
+  release(&wait_lock);
+
+  return pid;
+}
+
+// Called by a vfork() child in exec() or exit(): hand the
+// borrowed memory (root entries of pagetable, and its size)
+// back to the parent and wake it up.
+void
+vforkrelease(struct proc *p, pagetable_t pagetable, uint64 sz)
+{
+  struct proc *pp = p->vforkparent;
+
+  // 子进程可能sbrk过，根页表项和大小都要抄回去
+  for(int i = 0; i < NUSERPDE; i++){
+    pp->pagetable[i] = pagetable[i];
+    pagetable[i] = 0;
+  }
+  pp->sz = sz;
+
+  acquire(&wait_lock);
+  p->vforkparent = 0;
+  wakeup(p);
+  release(&wait_lock);
+}
+
 // Pass p's abandoned children to init.
 // Caller must hold wait_lock.
 void
@@ -356,6 +447,11 @@ exit(int status)
   if(p == initproc)
     panic("init exiting");
 
+  if(p->vforkparent){
+    vforkrelease(p, p->pagetable, p->sz);
+    p->sz = 0;
+  }
+
   // Close all open files.
   for(int fd = 0; fd < NOFILE; fd++){
     if(p->ofile[fd]){
@@ -669,11 +765,27 @@ procdump(void)
 
 int
 procnum(void)
-{//记录状态不是unused的进程数量并返回
+{//各CPU计数之和就是状态不是unused的进程数量
   int num=0;
-  for(int i=0;i<NPROC;i++){
-    if(proc[i].state != UNUSED)
-      num++;
-  }
+  for(int i=0;i<NCPU;i++)
+    num += nproc_cpu[i];
   return num;
-}
\ No newline at end of file
+}
+
+// Called from clockintr every LOAD_FREQ ticks (about 5 seconds).
+// Folds the number of runnable processes into the
+// 1, 5 and 15 minute exponential moving averages.
+void
+calcload(void)
+{
+  uint64 active = 0;
+  struct proc *p;
+
+  // 只是估计值，不加锁读state
+  for(p = proc; p < &proc[NPROC]; p++)
+    if(p->state == RUNNABLE || p->state == RUNNING)
+      active++;
+  active *= FIXED_1;
+  for(int i = 0; i < 3; i++)
+    loadavg[i] = (loadavg[i] * loadexp[i] + active * (FIXED_1 - loadexp[i])) >> SI_LOAD_SHIFT;
+}
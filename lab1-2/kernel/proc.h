@@ -105,5 +105,6 @@ struct proc {
   struct file *ofile[NOFILE];  // Open files
   struct inode *cwd;           // Current directory
   char name[16];               // Process name (debugging)
+  struct proc *vforkparent;    // 借用其内存的父进程，exec或exit时归还
   int trace_mask;    // trace系统调用参数
 };
@@ -21,4 +21,5 @@
 #define SYS_mkdir  20
 #define SYS_close  21
 #define SYS_trace  22
-#define SYS_sysinfo 23
\ No newline at end of file
+#define SYS_sysinfo 23
+#define SYS_vfork  24
\ No newline at end of file
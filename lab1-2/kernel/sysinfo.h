@@ -1,4 +1,12 @@
+#define SI_LOAD_SHIFT 11  // loadavg is fixed point with this many fraction bits
+
+// needs kernel/param.h for NCPU.
 struct sysinfo {
   uint64 freemem;   // amount of free memory (bytes)
   uint64 nproc;     // number of process
+  uint64 cowpages;  // pages shared copy-on-write (fork copies eagerly here, so 0)
+  uint64 nbuf;      // buffer cache blocks holding valid data
+  uint64 loadavg[3];  // 1, 5 and 15 minute load average
+  int cpufree[NCPU];  // pages freed minus pages allocated on each cpu
+  int cpualloc[NCPU]; // pages allocated on each cpu since boot
 };
@@ -30,6 +30,12 @@ sys_fork(void)
   return fork();
 }
 
+uint64
+sys_vfork(void)
+{
+  return vfork();
+}
+
 uint64
 sys_wait(void)
 {
@@ -113,6 +119,11 @@ sys_sysinfo(void)
   uint64 u_pointer;
   _info.freemem = kcount();
   _info.nproc = procnum();
+  _info.cowpages = 0;
+  _info.nbuf = bcount();
+  for(int i = 0; i < 3; i++)
+    _info.loadavg[i] = loadavg[i];
+  kcpucount(_info.cpufree, _info.cpualloc);
   struct proc *p = myproc();
   if(argaddr(0,&u_pointer)<0){
     return -1;//将返回给用户的数据放在a0寄存器当中
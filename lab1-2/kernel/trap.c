@@ -166,6 +166,8 @@ clockintr()
   ticks++;
   wakeup(&ticks);
   release(&tickslock);
+  if(ticks % LOAD_FREQ == 0)
+    calcload();
 }
 
 // check if it's an external interrupt or software interrupt,
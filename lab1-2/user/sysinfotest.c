@@ -1,4 +1,5 @@
 #include "kernel/types.h"
+#include "kernel/param.h"
 #include "kernel/riscv.h"
 #include "kernel/sysinfo.h"
 #include "user/user.h"
@@ -120,6 +121,85 @@ void testproc() {
   }
 }
 
+// 用sbrk和fork造成已知的变化，检查增量维护的freemem和nproc变化得一点不差
+#define NCOUNTPG 16
+#define NCOUNTPROC 3
+void testcounters() {
+  struct sysinfo info;
+  uint64 free0, nproc0;
+  int fds[2], status;
+  char c;
+
+  // 先分配释放一次，让用到的页表页都已经存在，之后sbrk只动数据页
+  if(sbrk(NCOUNTPG * PGSIZE) == (char*)-1){
+    printf("sysinfotest: FAIL sbrk failed\n");
+    exit(1);
+  }
+  sbrk(-NCOUNTPG * PGSIZE);
+  if(pipe(fds) < 0){
+    printf("sysinfotest: FAIL pipe failed\n");
+    exit(1);
+  }
+
+  sinfo(&info);
+  free0 = info.freemem;
+  nproc0 = info.nproc;
+  sbrk(NCOUNTPG * PGSIZE);
+  sinfo(&info);
+  if(info.freemem != free0 - NCOUNTPG * PGSIZE){
+    printf("sysinfotest: FAIL freemem is %d after sbrk, expected %d\n",
+      info.freemem, free0 - NCOUNTPG * PGSIZE);
+    exit(1);
+  }
+  sbrk(-NCOUNTPG * PGSIZE);
+  sinfo(&info);
+  if(info.freemem != free0){
+    printf("sysinfotest: FAIL freemem is %d after freeing, expected %d\n",
+      info.freemem, free0);
+    exit(1);
+  }
+
+  // 子进程都阻塞在管道上，这时应正好多出NCOUNTPROC个进程
+  for(int i = 0; i < NCOUNTPROC; i++){
+    int pid = fork();
+    if(pid < 0){
+      printf("sysinfotest: FAIL fork failed\n");
+      exit(1);
+    }
+    if(pid == 0){
+      close(fds[1]);
+      read(fds[0], &c, 1);
+      exit(0);
+    }
+  }
+  sinfo(&info);
+  if(info.nproc != nproc0 + NCOUNTPROC){
+    printf("sysinfotest: FAIL nproc is %d with children, expected %d\n",
+      info.nproc, nproc0 + NCOUNTPROC);
+    exit(1);
+  }
+  close(fds[1]);
+  for(int i = 0; i < NCOUNTPROC; i++)
+    wait(&status);
+  close(fds[0]);
+  sinfo(&info);
+  if(info.nproc != nproc0){
+    printf("sysinfotest: FAIL nproc is %d after wait, expected %d\n",
+      info.nproc, nproc0);
+    exit(1);
+  }
+  // 关掉的管道页也还回去了
+  if(info.freemem != free0 + PGSIZE){
+    printf("sysinfotest: FAIL freemem is %d after wait, expected %d\n",
+      info.freemem, free0 + PGSIZE);
+    exit(1);
+  }
+  if(info.nbuf > NBUF){
+    printf("sysinfotest: FAIL nbuf is %d, only %d buffers\n", info.nbuf, NBUF);
+    exit(1);
+  }
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -127,6 +207,7 @@ main(int argc, char *argv[])
   testcall();
   testmem();
   testproc();
+  testcounters();
   printf("sysinfotest: OK\n");
   exit(0);
 }
@@ -4,6 +4,7 @@ struct sysinfo;
 
 // system calls
 int fork(void);
+int vfork(void);
 int exit(int) __attribute__((noreturn));
 int wait(int*);
 int pipe(int*);
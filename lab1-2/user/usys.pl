@@ -37,4 +37,5 @@ entry("sbrk");
 entry("sleep");
 entry("uptime");
 entry("trace");
-entry("sysinfo");
\ No newline at end of file
+entry("sysinfo");
+entry("vfork");
\ No newline at end of file
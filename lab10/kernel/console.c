@@ -84,6 +84,9 @@ consoleread(int user_dst, uint64 dst, int n)
   char cbuf;
 
   target = n;
+  // 持锁时copyout不能从文件读入页面，先让整个缓冲区就位
+  if(user_dst)
+    uvmresident(myproc()->pagetable, dst, n);
   acquire(&cons.lock);
   while(n > 0){
     // wait until interrupt handler has put some
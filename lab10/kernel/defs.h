@@ -8,6 +8,7 @@ struct spinlock;
 struct sleeplock;
 struct stat;
 struct superblock;
+struct vm_area;
 
 // bio.c
 void            binit(void);
@@ -63,6 +64,8 @@ void            ramdiskrw(struct buf*);
 void*           kalloc(void);
 void            kfree(void *);
 void            kinit(void);
+void            incr(void *);
+int             pagerefs(void *);
 
 // log.c
 void            initlog(int, struct superblock*);
@@ -70,6 +73,13 @@ void            log_write(struct buf*);
 void            begin_op(void);
 void            end_op(void);
 
+// pcache.c
+void            pcinit(void);
+char*           pcget(struct inode*, uint, int);
+void            pcwrite(struct inode*, uint, char*, uint);
+void            pcinval(struct inode*);
+int             pcreclaim(void);
+
 // pipe.c
 int             pipealloc(struct file**, struct file**);
 void            pipeclose(struct pipe*, int);
@@ -104,6 +114,9 @@ void            yield(void);
 int             either_copyout(int user_dst, uint64 dst, void *src, uint64 len);
 int             either_copyin(void *dst, int user_src, uint64 src, uint64 len);
 void            procdump(void);
+void            asidinit(void);
+uint64          usersatp(struct proc*);
+void            tlbflush(pagetable_t, uint64, uint64);
 
 // swtch.S
 void            swtch(struct context*, struct context*);
@@ -163,10 +176,14 @@ void            uvminit(pagetable_t, uchar *, uint);
 uint64          uvmalloc(pagetable_t, uint64, uint64);
 uint64          uvmdealloc(pagetable_t, uint64, uint64);
 int             uvmcopy(pagetable_t, pagetable_t, uint64);
+int             uvmcopyrange(pagetable_t, pagetable_t, uint64, uint64);
 void            uvmfree(pagetable_t, uint64);
 void            uvmunmap(pagetable_t, uint64, uint64, int);
 void            uvmclear(pagetable_t, uint64);
+pte_t *         walk(pagetable_t, uint64, int);
 uint64          walkaddr(pagetable_t, uint64);
+int             uvmresident(pagetable_t, uint64, uint64);
+int             cow_alloc(pagetable_t, uint64);
 int             copyout(pagetable_t, uint64, char *, uint64);
 int             copyin(pagetable_t, char *, uint64, uint64);
 int             copyinstr(pagetable_t, char *, uint64, uint64);
@@ -177,12 +194,28 @@ void            plicinithart(void);
 int             plic_claim(void);
 void            plic_complete(int);
 
+// vma.c
+void            vmainit(void);
+struct vm_area* vma_alloc(void);
+void            vma_free(struct vm_area*);
+struct vm_area* vma_next(struct proc*, uint64);
+struct vm_area* vma_find(struct proc*, uint64);
+void            vma_insert(struct proc*, struct vm_area*);
+void            vma_remove(struct proc*, struct vm_area*);
+void            vma_trim(struct vm_area*, uint64, uint64);
+void            vma_split(struct proc*, struct vm_area*, uint64, struct vm_area*);
+uint64          vma_place(struct proc*, uint64, uint64);
+int             vma_dup(struct proc*, struct proc*);
+void            vma_drop(struct proc*);
+
 // virtio_disk.c
 void            virtio_disk_init(void);
 void            virtio_disk_rw(struct buf *, int);
 void            virtio_disk_intr(void);
+uint64          virtio_disk_nwrite(void);
 
 // number of elements in fixed-size array
 #define NELEM(x) (sizeof(x)/sizeof((x)[0]))
 
-int mmap_handler(int va, int cause);
\ No newline at end of file
+int mmap_handler(uint64 va, int cause);
+void vmaclose(struct proc *p);
@@ -6,8 +6,12 @@
 #include "proc.h"
 #include "defs.h"
 #include "elf.h"
+#include "fs.h"
+#include "sleeplock.h"
+#include "file.h"
+#include "fcntl.h"
 
-static int loadseg(pde_t *pgdir, uint64 addr, struct inode *ip, uint offset, uint sz);
+#define NEXECVMA 4  // 可加载段的最大个数，每段占一个VMA
 
 int
 exec(char *path, char **argv)
@@ -20,6 +24,9 @@ exec(char *path, char **argv)
   struct proghdr ph;
   pagetable_t pagetable = 0, oldpagetable;
   struct proc *p = myproc();
+  struct vm_area *seg[NEXECVMA];
+  int nseg = 0;
+  struct file *f = 0;
 
   begin_op();
 
@@ -38,7 +45,16 @@ exec(char *path, char **argv)
   if((pagetable = proc_pagetable(p)) == 0)
     goto bad;
 
-  // Load program into memory.
+  // 各段都是可执行文件的私有映射，用一个只读的file表示这个文件
+  if((f = filealloc()) == 0)
+    goto bad;
+  f->type = FD_INODE;
+  f->ip = idup(ip);
+  f->off = 0;
+  f->readable = 1;
+  f->writable = 0;
+
+  // 只记下每个段对应文件的哪一部分，页面在第一次访问时由mmap_handler读入
   for(i=0, off=elf.phoff; i<elf.phnum; i++, off+=sizeof(ph)){
     if(readi(ip, 0, (uint64)&ph, off, sizeof(ph)) != sizeof(ph))
       goto bad;
@@ -48,14 +64,28 @@ exec(char *path, char **argv)
       goto bad;
     if(ph.vaddr + ph.memsz < ph.vaddr)
       goto bad;
-    uint64 sz1;
-    if((sz1 = uvmalloc(pagetable, sz, ph.vaddr + ph.memsz)) == 0)
+    if(ph.vaddr + ph.memsz >= MAXVA)
       goto bad;
-    sz = sz1;
     if((ph.vaddr % PGSIZE) != 0)
       goto bad;
-    if(loadseg(pagetable, ph.vaddr, ip, ph.off, ph.filesz) < 0)
+    // VMA之间不能重叠
+    if(ph.vaddr < sz)
+      goto bad;
+    if(ph.memsz == 0)
+      continue;
+    if(nseg == NEXECVMA)
+      goto bad;
+    if((seg[nseg] = vma_alloc()) == 0)
       goto bad;
+    seg[nseg]->addr = ph.vaddr;
+    seg[nseg]->len = PGROUNDUP(ph.memsz);
+    seg[nseg]->prot = PROT_READ | PROT_WRITE | PROT_EXEC;  // 和原来uvmalloc给的权限一样
+    seg[nseg]->flags = MAP_PRIVATE;
+    seg[nseg]->vfile = filedup(f);
+    seg[nseg]->offset = ph.off;
+    seg[nseg]->filesz = ph.filesz;
+    nseg++;
+    sz = ph.vaddr + ph.memsz;
   }
   iunlockput(ip);
   end_op();
@@ -109,8 +139,14 @@ exec(char *path, char **argv)
   safestrcpy(p->name, last, sizeof(p->name));
     
   // Commit to the user image.
+  // 旧映像的mmap区域随旧页表一起作废，换上新映像的段
+  vmaclose(p);
+  for(i = 0; i < nseg; i++)
+    vma_insert(p, seg[i]);
+  fileclose(f);
   oldpagetable = p->pagetable;
   p->pagetable = pagetable;
+  p->asid = 0;  // 新页表用新的ASID，旧ASID的表项不会再被用到
   p->sz = sz;
   p->trapframe->epc = elf.entry;  // initial program counter = main
   p->trapframe->sp = sp; // initial stack pointer
@@ -125,30 +161,12 @@ exec(char *path, char **argv)
     iunlockput(ip);
     end_op();
   }
-  return -1;
-}
-
-// Load a program segment into pagetable at virtual address va.
-// va must be page-aligned
-// and the pages from va to va+sz must already be mapped.
-// Returns 0 on success, -1 on failure.
-static int
-loadseg(pagetable_t pagetable, uint64 va, struct inode *ip, uint offset, uint sz)
-{
-  uint i, n;
-  uint64 pa;
-
-  for(i = 0; i < sz; i += PGSIZE){
-    pa = walkaddr(pagetable, va + i);
-    if(pa == 0)
-      panic("loadseg: address should exist");
-    if(sz - i < PGSIZE)
-      n = sz - i;
-    else
-      n = PGSIZE;
-    if(readi(ip, 0, (uint64)pa, offset+i, n) != n)
-      return -1;
+  // fileclose()自己开启文件系统操作，所以放在end_op()之后
+  for(i = 0; i < nseg; i++){
+    fileclose(seg[i]->vfile);
+    vma_free(seg[i]);
   }
-  
-  return 0;
+  if(f)
+    fileclose(f);
+  return -1;
 }
@@ -118,6 +118,9 @@ fileread(struct file *f, uint64 addr, int n)
       return -1;
     r = devsw[f->major].read(1, addr, n);
   } else if(f->type == FD_INODE){
+    // 缓冲区可能映射着这个文件，在那里缺页要ilock，所以先调入
+    if(n > 0)
+      uvmresident(myproc()->pagetable, addr, n);
     ilock(f->ip);
     if((r = readi(f->ip, 1, addr, f->off, n)) > 0)
       f->off += r;
@@ -154,6 +157,9 @@ filewrite(struct file *f, uint64 addr, int n)
     // might be writing a device like the console.
     int max = ((MAXOPBLOCKS-1-1-2) / 2) * BSIZE;
     int i = 0;
+    // 同fileread，拿inode锁之前让缓冲区就位
+    if(n > 0)
+      uvmresident(myproc()->pagetable, addr, n);
     while(i < n){
       int n1 = n - i;
       if(n1 > max)
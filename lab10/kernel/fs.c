@@ -353,6 +353,10 @@ iput(struct inode *ip)
     acquire(&itable.lock);
   }
 
+  // 没人打开、运行或映射这个文件了，它在页缓存中的页也不用留着
+  if(ip->ref == 1)
+    pcinval(ip);
+
   ip->ref--;
   release(&itable.lock);
 }
@@ -434,6 +438,7 @@ itrunc(struct inode *ip)
 
   ip->size = 0;
   iupdate(ip);
+  pcinval(ip);
 }
 
 // Copy stat information from inode.
@@ -501,6 +506,7 @@ writei(struct inode *ip, int user_src, uint64 src, uint off, uint n)
       brelse(bp);
       break;
     }
+    pcwrite(ip, off, (char*)bp->data + (off % BSIZE), m);  // 映射着这部分文件的页也要更新
     log_write(bp);
     brelse(bp);
   }
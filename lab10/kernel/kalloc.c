@@ -23,6 +23,25 @@ struct {
   struct run *freelist;
 } kmem;
 
+// 每个物理页的引用计数，以(pa-KERNBASE)/PGSIZE为下标。
+// 页缓存中的页被多个进程共享映射时大于1。
+int refcnt[(PHYSTOP-KERNBASE)/PGSIZE];
+#define PA2REF(pa) (&refcnt[((uint64)(pa) - KERNBASE) / PGSIZE])
+
+// 增加一个引用（又一个页表或页缓存持有这一页时）
+void
+incr(void *pa)
+{
+  __sync_fetch_and_add(PA2REF(pa), 1);
+}
+
+// 这一页现在有几个引用
+int
+pagerefs(void *pa)
+{
+  return *PA2REF(pa);
+}
+
 void
 kinit()
 {
@@ -35,8 +54,10 @@ freerange(void *pa_start, void *pa_end)
 {
   char *p;
   p = (char*)PGROUNDUP((uint64)pa_start);
-  for(; p + PGSIZE <= (char*)pa_end; p += PGSIZE)
+  for(; p + PGSIZE <= (char*)pa_end; p += PGSIZE){
+    *PA2REF(p) = 1;
     kfree(p);
+  }
 }
 
 // Free the page of physical memory pointed at by v,
@@ -51,6 +72,13 @@ kfree(void *pa)
   if(((uint64)pa % PGSIZE) != 0 || (char*)pa < end || (uint64)pa >= PHYSTOP)
     panic("kfree");
 
+  //只有最后一个引用去掉时才真正释放，否则只是减一
+  int ref = __sync_sub_and_fetch(PA2REF(pa), 1);
+  if(ref > 0)
+    return;
+  if(ref < 0)
+    panic("kfree: double free");
+
   // Fill with junk to catch dangling refs.
   memset(pa, 1, PGSIZE);
 
@@ -76,7 +104,13 @@ kalloc(void)
     kmem.freelist = r->next;
   release(&kmem.lock);
 
-  if(r)
+  // 没有空闲页了：先收回页缓存中没人映射的页再试
+  if(r == 0 && pcreclaim() > 0)
+    return kalloc();
+
+  if(r){
+    *PA2REF(r) = 1;
     memset((char*)r, 5, PGSIZE); // fill with junk
+  }
   return (void*)r;
 }
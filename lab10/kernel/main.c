@@ -20,6 +20,7 @@ main()
     kvminit();       // create kernel page table
     kvminithart();   // turn on paging
     procinit();      // process table
+    asidinit();      // probe ASID support
     trapinit();      // trap vectors
     trapinithart();  // install kernel trap vector
     plicinit();      // set up interrupt controller
@@ -27,6 +28,8 @@ main()
     binit();         // buffer cache
     iinit();         // inode table
     fileinit();      // file table
+    pcinit();        // file page cache
+    vmainit();       // vm_area allocator
     virtio_disk_init(); // emulated hard disk
     userinit();      // first user process
     __sync_synchronize();
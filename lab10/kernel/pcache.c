@@ -0,0 +1,239 @@
+// Cache of file pages, keyed by (dev, inum, offset).
+//
+// mmap() and exec() map file pages through this cache, so every
+// process mapping the same part of a file uses one physical copy
+// and only the first fault reads it from disk. MAP_SHARED maps
+// the cached page itself, writable if the mapping is, so all
+// sharers see each other's stores. MAP_PRIVATE and exec() map it
+// read-only with PTE_COW, and a process that writes such a page
+// gets a private copy (see cow_alloc()).
+//
+// The cache holds one reference to each of its pages (see
+// incr() in kalloc.c) and every mapping holds another, so a page
+// is freed only when it has left the cache and is no longer
+// mapped. Only pages nobody maps are evicted, so a page stays
+// cached, and shared, while a process still maps it; when every
+// cached page is mapped, the cache grows by a page of entries,
+// which is never given back. Pages nobody maps are freed when
+// kalloc() runs out of memory (see pcreclaim()), and all of a
+// file's pages when its last reference goes away in iput().
+//
+// write() copies the new bytes into a cached page as well as into
+// the buffer cache if nobody maps the page or a MAP_SHARED mapping
+// has used it; MAP_PRIVATE mappings of that page that have not
+// yet copied it see the write too. A page that only MAP_PRIVATE
+// mappings and exec() segments map is dropped from the cache
+// instead, so running programs keep their text, as they do when a
+// file is truncated; later faults read the new contents. A store
+// through a MAP_SHARED mapping reaches the disk only when the
+// mapping is written back by munmap() or exit().
+
+#include "types.h"
+#include "param.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "fs.h"
+#include "file.h"
+#include "defs.h"
+
+struct pcentry {
+  uint dev;
+  uint inum;
+  uint off;    // file offset of the page's first byte
+  char *pa;    // 0 if the entry is unused
+  uint used;   // pcache.clock at the last hit, for LRU
+  int shared;  // a MAP_SHARED mapping has used the page
+  struct pcentry *next;   // all entries
+  struct pcentry *hnext;  // entries in use, in the same bucket
+};
+
+#define NPCHASH 61
+
+struct {
+  struct spinlock lock;
+  struct pcentry e[NPCACHE];
+  struct pcentry *head;  // all entries, through next
+  struct pcentry *hash[NPCHASH];  // entries in use, through hnext
+  uint clock;
+} pcache;
+
+void
+pcinit(void)
+{
+  initlock(&pcache.lock, "pcache");
+  for(struct pcentry *e = pcache.e; e < &pcache.e[NPCACHE]; e++){
+    e->next = pcache.head;
+    pcache.head = e;
+  }
+}
+
+static struct pcentry **
+pcbucket(uint dev, uint inum, uint off)
+{
+  return &pcache.hash[(dev * 31 + inum * 17 + off / PGSIZE) % NPCHASH];
+}
+
+static struct pcentry *
+pclookup(uint dev, uint inum, uint off)
+{
+  for(struct pcentry *e = *pcbucket(dev, inum, off); e; e = e->hnext)
+    if(e->dev == dev && e->inum == inum && e->off == off)
+      return e;
+  return 0;
+}
+
+// Take e's page out of the cache and drop the cache's reference.
+static void
+pcdrop(struct pcentry *e)
+{
+  struct pcentry **pp = pcbucket(e->dev, e->inum, e->off);
+
+  while(*pp != e)
+    pp = &(*pp)->hnext;
+  *pp = e->hnext;
+  kfree(e->pa);
+  e->pa = 0;
+}
+
+// An unused entry, else the least recently used one whose page
+// nobody maps, else 0. Evicting a mapped page would give later
+// faults a second copy, and MAP_SHARED mappings of the two copies
+// would not see each other's stores.
+static struct pcentry *
+pcvictim(void)
+{
+  struct pcentry *e, *v = 0;
+
+  for(e = pcache.head; e; e = e->next){
+    if(e->pa == 0)
+      return e;
+    if(pagerefs(e->pa) == 1 && (v == 0 || e->used < v->used))
+      v = e;
+  }
+  return v;
+}
+
+// Return the page holding the PGSIZE bytes of ip at off, reading
+// it if it is not cached, with a reference added for the caller
+// to map. shared says whether a MAP_SHARED mapping will map it.
+// Bytes past the end of the file read as zeros. Returns 0 if the
+// read fails or there is no memory.
+// Caller must hold ip->lock, so nobody else can add or drop
+// this file's pages meanwhile.
+char *
+pcget(struct inode *ip, uint off, int shared)
+{
+  struct pcentry *e, *victim;
+  char *pa, *more;
+  uint n;
+
+  acquire(&pcache.lock);
+  if((e = pclookup(ip->dev, ip->inum, off)) != 0){
+    e->used = ++pcache.clock;
+    e->shared |= shared;
+    pa = e->pa;
+    incr(pa);
+    release(&pcache.lock);
+    return pa;
+  }
+  release(&pcache.lock);
+
+  // readi()会睡眠，不能持有自旋锁
+  if((pa = kalloc()) == 0)
+    return 0;
+  memset(pa, 0, PGSIZE);
+  n = off < ip->size ? ip->size - off : 0;
+  if(n > PGSIZE)
+    n = PGSIZE;
+  if(readi(ip, 0, (uint64)pa, off, n) != n){
+    kfree(pa);
+    return 0;
+  }
+
+  // 缓存的页都被映射着时，再要一页来放表项
+  acquire(&pcache.lock);
+  while((victim = pcvictim()) == 0){
+    release(&pcache.lock);
+    if((more = kalloc()) == 0){
+      kfree(pa);
+      return 0;
+    }
+    acquire(&pcache.lock);
+    for(e = (struct pcentry*)more; e + 1 <= (struct pcentry*)(more + PGSIZE); e++){
+      e->pa = 0;
+      e->next = pcache.head;
+      pcache.head = e;
+    }
+  }
+  if(victim->pa)
+    pcdrop(victim);
+  victim->dev = ip->dev;
+  victim->inum = ip->inum;
+  victim->off = off;
+  victim->pa = pa;
+  victim->used = ++pcache.clock;
+  victim->shared = shared;
+  victim->hnext = *pcbucket(ip->dev, ip->inum, off);
+  *pcbucket(ip->dev, ip->inum, off) = victim;
+  incr(pa);
+  release(&pcache.lock);
+  return pa;
+}
+
+// n bytes at src have been written to ip at off: copy them into
+// the cached pages they fall in, so that mappings see them, or
+// drop the pages only private mappings map.
+// Caller must hold ip->lock.
+void
+pcwrite(struct inode *ip, uint off, char *src, uint n)
+{
+  struct pcentry *e;
+  uint m;
+
+  acquire(&pcache.lock);
+  for(; n > 0; n -= m, off += m, src += m){
+    m = PGSIZE - off % PGSIZE;
+    if(m > n)
+      m = n;
+    if((e = pclookup(ip->dev, ip->inum, PGROUNDDOWN(off))) == 0)
+      continue;
+    if(e->shared || pagerefs(e->pa) == 1){
+      memmove(e->pa + off % PGSIZE, src, m);
+    } else {
+      // 只有私有映射（比如正在运行的程序的代码段）用着这页：让它们留着旧内容
+      pcdrop(e);
+    }
+  }
+  release(&pcache.lock);
+}
+
+// ip has been truncated, or nobody uses it any more:
+// forget its cached pages.
+void
+pcinval(struct inode *ip)
+{
+  acquire(&pcache.lock);
+  for(struct pcentry *e = pcache.head; e; e = e->next)
+    if(e->pa && e->dev == ip->dev && e->inum == ip->inum)
+      pcdrop(e);
+  release(&pcache.lock);
+}
+
+// Free the pages that only the cache holds. kalloc() calls this
+// when its free list is empty. Returns the number of pages freed.
+int
+pcreclaim(void)
+{
+  int n = 0;
+
+  acquire(&pcache.lock);
+  for(struct pcentry *e = pcache.head; e; e = e->next){
+    if(e->pa && pagerefs(e->pa) == 1){
+      pcdrop(e);
+      n++;
+    }
+  }
+  release(&pcache.lock);
+  return n;
+}
@@ -141,7 +141,9 @@ found:
   memset(&p->context, 0, sizeof(p->context));
   p->context.ra = (uint64)forkret;
   p->context.sp = p->kstack + PGSIZE;
-  memset(&p->vma, 0, sizeof(p->vma));//vma初始化为0
+  p->vmaroot = 0;//还没有vma
+  p->vmalist = 0;
+  p->nvma = 0;
   return p;
 }
 
@@ -164,6 +166,8 @@ freeproc(struct proc *p)
   p->chan = 0;
   p->killed = 0;
   p->xstate = 0;
+  p->asid = 0;
+  p->tlbstale = 0;
   p->state = UNUSED;
 }
 
@@ -255,9 +259,13 @@ growproc(int n)
 {
   uint sz;
   struct proc *p = myproc();
+  struct vm_area *v;
 
   sz = p->sz;
   if(n > 0){
+    // 堆不能长进上面的mmap区域
+    if((v = vma_next(p, sz)) != 0 && (uint64)sz + n > v->addr)
+      return -1;
     if((sz = uvmalloc(p->pagetable, sz, sz + n)) == 0) {
       return -1;
     }
@@ -290,6 +298,14 @@ fork(void)
   }
   np->sz = p->sz;
 
+  // 复制父进程的VMA，以及sz之上mmap区域里已经映射的页
+  if(vma_dup(p, np) < 0){
+    vma_drop(np);
+    freeproc(np);
+    release(&np->lock);
+    return -1;
+  }
+
   // copy saved user registers.
   *(np->trapframe) = *(p->trapframe);
 
@@ -302,14 +318,6 @@ fork(void)
       np->ofile[i] = filedup(p->ofile[i]);
   np->cwd = idup(p->cwd);
 
-  // 复制父进程的VMA
-  for(i = 0; i < NVMA; ++i) {
-    if(p->vma[i].used) {
-      memmove(&np->vma[i], &p->vma[i], sizeof(p->vma[i]));
-      filedup(p->vma[i].vfile);
-    }
-  }
-
   safestrcpy(np->name, p->name, sizeof(p->name));
 
   pid = np->pid;
@@ -363,17 +371,7 @@ exit(int status)
   }
 
   // 将进程的已映射区域取消映射
-  for(int i = 0; i < NVMA; ++i) {
-    if(p->vma[i].used) {
-      // 映射的MAP_SHARED文件写回
-      if(p->vma[i].flags == MAP_SHARED && (p->vma[i].prot & PROT_WRITE) != 0) {
-        filewrite(p->vma[i].vfile, p->vma[i].addr, p->vma[i].len);
-      }
-      fileclose(p->vma[i].vfile);
-      uvmunmap(p->pagetable, p->vma[i].addr, p->vma[i].len / PGSIZE, 1);
-      p->vma[i].used = 0;
-    }
-  }
+  vmaclose(p);
 
   begin_op();
   iput(p->cwd);
@@ -409,6 +407,10 @@ wait(uint64 addr)
   int havekids, pid;
   struct proc *p = myproc();
 
+  // 持锁时copyout不能从文件读入页面，先让目标页就位
+  if(addr != 0)
+    uvmresident(p->pagetable, addr, sizeof(int));
+
   acquire(&wait_lock);
 
   for(;;){
@@ -676,3 +678,104 @@ procdump(void)
     printf("\n");
   }
 }
+
+// ASIDs let each process keep its TLB entries across traps and
+// context switches instead of flushing the whole TLB every time.
+// ASIDs are handed out in generations: once all are used up, a
+// new generation starts, every process gets a fresh ASID the next
+// time it returns to user space, and every CPU flushes its whole
+// TLB once before running a process of the new generation.
+#define ASID(x)    ((x) & SATP_ASID_MASK)
+#define ASIDGEN(x) ((x) >> 16)
+#define TLBFLUSH_MAX 16   // 超过这么多页就整个ASID一起刷新
+
+struct {
+  struct spinlock lock;
+  uint64 max;   // 硬件支持的最大ASID，0表示不支持
+  uint64 gen;   // 当前代号，从1开始，所以p->asid为0总是过期的
+  uint64 next;  // 本代下一个未分配的ASID
+} asids;
+
+// Find out how many ASID bits the hardware implements by writing
+// all ones into satp's ASID field and reading it back.
+void
+asidinit(void)
+{
+  uint64 satp = r_satp();
+
+  initlock(&asids.lock, "asid");
+  w_satp(satp | (SATP_ASID_MASK << SATP_ASID_SHIFT));
+  asids.max = (r_satp() >> SATP_ASID_SHIFT) & SATP_ASID_MASK;
+  w_satp(satp);
+  sfence_vma();
+  asids.gen = 1;
+  asids.next = 1;   // ASID 0留给内核页表
+  printf("asid: max %d\n", (int)asids.max);
+}
+
+// Return the satp value for p's page table, first giving p
+// a current ASID and flushing whatever this CPU may still hold
+// for it. Called by usertrapret() with interrupts off.
+uint64
+usersatp(struct proc *p)
+{
+  struct cpu *c = mycpu();
+  uint64 mask = 1L << cpuid();
+
+  if(asids.max == 0)
+    return MAKE_SATP(p->pagetable);
+
+  // 常见情况：p的ASID和本CPU都属于当前这一代，不用拿全局的锁。
+  // 检查之后别的CPU开始新一代也没关系，加锁的路径同样有这个窗口：
+  // p下次返回用户态时会发现代号过期，本CPU那时再整个刷新
+  uint64 gen = __atomic_load_n(&asids.gen, __ATOMIC_ACQUIRE);
+  if(ASIDGEN(p->asid) == gen && c->asidgen == gen)
+    goto stale;
+
+  acquire(&asids.lock);
+  if(ASIDGEN(p->asid) != asids.gen){
+    if(asids.next > asids.max){
+      __atomic_store_n(&asids.gen, asids.gen + 1, __ATOMIC_RELEASE);
+      asids.next = 1;
+    }
+    // 本代中这个ASID还没用过，已按本代刷新过的CPU里没有它的表项
+    p->asid = (asids.gen << 16) | asids.next++;
+    p->tlbstale = 0;
+  }
+  if(c->asidgen != asids.gen){
+    c->asidgen = asids.gen;
+    sfence_vma();
+  }
+  release(&asids.lock);
+
+stale:
+  if(p->tlbstale & mask){
+    __sync_fetch_and_and(&p->tlbstale, ~mask);
+    sfence_vma_asid(ASID(p->asid));
+  }
+  return MAKE_SATP(p->pagetable) | (ASID(p->asid) << SATP_ASID_SHIFT);
+}
+
+// The user mappings of npages pages at va in pagetable have
+// changed. If pagetable is the current process's, flush them
+// from this CPU's TLB now, and make the other CPUs flush the
+// process's ASID before they next run it.
+void
+tlbflush(pagetable_t pagetable, uint64 va, uint64 npages)
+{
+  struct proc *p = myproc();
+  uint64 asid;
+
+  if(asids.max == 0 || p == 0 || p->pagetable != pagetable)
+    return;
+  push_off();
+  asid = ASID(p->asid);
+  if(npages > TLBFLUSH_MAX){
+    sfence_vma_asid(asid);
+  } else {
+    for(uint64 i = 0; i < npages; i++)
+      sfence_vma_page(va + i*PGSIZE, asid);
+  }
+  __sync_fetch_and_or(&p->tlbstale, ~(1L << cpuid()));
+  pop_off();
+}
@@ -24,6 +24,7 @@ struct cpu {
   struct context context;     // swtch() here to enter scheduler().
   int noff;                   // Depth of push_off() nesting.
   int intena;                 // Were interrupts enabled before push_off()?
+  uint64 asidgen;             // ASID generation this CPU's TLB was last flushed for
 };
 
 extern struct cpu cpus[NCPU];
@@ -82,17 +83,20 @@ struct trapframe {
 
 enum procstate { UNUSED, USED, SLEEPING, RUNNABLE, RUNNING, ZOMBIE };
 
-#define NVMA 16
-// 虚拟内存区域结构体
+#define NVMA 1024  // 每个进程最多的VMA数
+// 虚拟内存区域结构体，由vma.c分配，每个进程的VMA按地址排序，
+// 既放在一棵AVL树里（按地址查找），又串成一个链表（找相邻的VMA）
 struct vm_area {
-  int used;           // 是否已被使用
-  uint64 addr;        // 起始地址
-  int len;            // 长度
+  uint64 addr;        // 起始地址，页对齐
+  uint64 len;         // 长度，页的整数倍
   int prot;           // 权限
   int flags;          // 标志位
-  int vfd;            // 对应的文件描述符
   struct file* vfile; // 对应文件
-  int offset;         // 文件偏移，本实验中一直为0
+  int offset;         // addr处对应的文件偏移，exec的段为ph.off
+  uint64 filesz;      // 从文件读取的字节数，之后到len为止的部分填0（exec的bss）
+  struct vm_area *left, *right;  // AVL树
+  int height;
+  struct vm_area *prev, *next;   // 按地址从低到高的链表
 };
 
 // Per-process state
@@ -118,5 +122,9 @@ struct proc {
   struct file *ofile[NOFILE];  // Open files
   struct inode *cwd;           // Current directory
   char name[16];               // Process name (debugging)
-  struct vm_area vma[NVMA];    // 虚拟内存区域
+  struct vm_area *vmaroot;     // 虚拟内存区域：AVL树的根
+  struct vm_area *vmalist;     // 地址最低的VMA，链表头
+  int nvma;                    // VMA个数
+  uint64 asid;                 // 代号<<16 | ASID，0表示尚未分配
+  uint64 tlbstale;             // 位图：这些CPU的TLB里可能有本ASID的过期表项
 };
@@ -485,6 +485,72 @@ sys_pipe(void)
   return 0;
 }
 
+// Write n bytes of the mapping v at va back to its file, a few
+// blocks per transaction. Stops at the end of the file: a
+// mapping does not change the file's size.
+static int
+vmawrite(struct vm_area *v, uint64 va, uint64 n)
+{
+  struct inode *ip = v->vfile->ip;
+  uint off = v->offset + (va - v->addr);
+  uint64 i;
+  int n1, r;
+
+  for(i = 0; i < n; i += n1){
+    // 写的是文件已有的块，writei()不会分配新块，一次事务只写
+    // 这些数据块和inode，所以比filewrite()一次能多写不少
+    n1 = (MAXOPBLOCKS-1) * BSIZE - (off + i) % BSIZE;
+    if(n1 > n - i)
+      n1 = n - i;
+    begin_op();
+    ilock(ip);
+    if(off + i >= ip->size){
+      iunlock(ip);
+      end_op();
+      break;
+    }
+    if(n1 > ip->size - (off + i))
+      n1 = ip->size - (off + i);
+    r = writei(ip, 1, va + i, off + i, n1);
+    iunlock(ip);
+    end_op();
+    if(r != n1)
+      return -1;
+  }
+  return 0;
+}
+
+// Write back the part [addr, addr+len) of p's mapping v if it
+// is a writable MAP_SHARED mapping. Only pages that are present
+// and have PTE_D set were written since they were faulted in;
+// runs of adjacent ones go out together, and other pages are
+// neither read nor faulted in.
+static void
+vmawriteback(struct vm_area *v, uint64 addr, uint64 len)
+{
+  pagetable_t pagetable = myproc()->pagetable;
+  uint64 va, end = addr + len, start = 0;
+  int run = 0, dirty;
+  pte_t *pte;
+
+  if(v->flags != MAP_SHARED || (v->prot & PROT_WRITE) == 0)
+    return;
+  for(va = PGROUNDDOWN(addr); ; va += PGSIZE){
+    dirty = 0;
+    if(va < end && (pte = walk(pagetable, va, 0)) != 0)
+      dirty = (*pte & (PTE_V | PTE_D)) == (PTE_V | PTE_D);
+    if(dirty && !run){
+      start = va > addr ? va : addr;
+      run = 1;
+    } else if(!dirty && run){
+      vmawrite(v, start, (va < end ? va : end) - start);
+      run = 0;
+    }
+    if(va >= end)
+      break;
+  }
+}
+
 //只做好了简单的预留位置工作（记录metadata），并没有做实质性的内存分配和数据拷贝工作
 uint64
 sys_mmap(void) {
@@ -496,14 +562,15 @@ sys_mmap(void) {
   struct file* vfile;
   int offset;
   uint64 err = 0xffffffffffffffff;
+  struct vm_area *v;
 
   // 获取系统调用参数
   if(argaddr(0, &addr) < 0 || argint(1, &length) < 0 || argint(2, &prot) < 0 ||
     argint(3, &flags) < 0 || argfd(4, &vfd, &vfile) < 0 || argint(5, &offset) < 0)
     return err;
 
-  // 实验提示中假定addr和offset为0，简化程序可能发生的情况
-  if(addr != 0 || offset != 0 || length < 0)
+  // addr只是建议的位置；offset要页对齐
+  if(length <= 0 || offset < 0 || offset % PGSIZE != 0)
     return err;
   // 对映射的文件进行权限的检查
   // 本身的文件不可写则，不允许拥有PROT_WRITE权限时映射为MAP_SHARED
@@ -511,137 +578,186 @@ sys_mmap(void) {
     return err;
 
   struct proc* p = myproc();
-  // 没有足够的虚拟地址空间，合法性检查
-  if(p->sz + length > MAXVA)
+  // 在MMAPTOP以下找一段没被占用的虚拟地址空间
+  if(p->nvma >= NVMA || (addr = vma_place(p, addr, PGROUNDUP(length))) == 0)
     return err;
-
-  // 遍历查找未使用的VMA结构体
-  for(int i = 0; i < NVMA; ++i) {
-    if(p->vma[i].used == 0) {
-      p->vma[i].used = 1;
-      p->vma[i].addr = p->sz;
-      p->vma[i].len = length;
-      p->vma[i].flags = flags;
-      p->vma[i].prot = prot;
-      p->vma[i].vfile = vfile;
-      p->vma[i].vfd = vfd;
-      p->vma[i].offset = offset;
-
-      // 增加文件的引用计数
-      // mmap should increase the file’s reference count 
-      // so that the structure doesn’t disappear 
-      // when the file is closed (hint: see filedup).
-      filedup(vfile);
-
-      p->sz += length;
-      return p->vma[i].addr;
-    }
-  }
-
-  return err;
+  if((v = vma_alloc()) == 0)
+    return err;
+  v->addr = addr;
+  v->len = PGROUNDUP(length);
+  v->flags = flags;
+  v->prot = prot;
+  v->offset = offset;
+  v->filesz = v->len;  // 文件末尾之后的部分由pcget()填0
+
+  // 增加文件的引用计数
+  // mmap should increase the file’s reference count 
+  // so that the structure doesn’t disappear 
+  // when the file is closed (hint: see filedup).
+  v->vfile = filedup(vfile);
+
+  // 和相邻的兼容的VMA合并，v可能被释放
+  vma_insert(p, v);
+  return addr;
 }
 
 uint64
 sys_munmap(void) {
-  uint64 addr;
+  uint64 addr, end;
   int length;
+  struct vm_area *v, *next, *nv = 0;
   if(argaddr(0, &addr) < 0 || argint(1, &length) < 0)
     return -1;
+  if(addr % PGSIZE != 0 || length <= 0 || addr + length > MAXVA)
+    return -1;
+  end = PGROUNDUP(addr + length);
 
-  int i;
   struct proc* p = myproc();
-  for(i = 0; i < NVMA; ++i) {
-    if(p->vma[i].used && p->vma[i].len >= length) {
-      // 根据提示，munmap的地址范围只能是
-      // 1. 起始位置
-      if(p->vma[i].addr == addr) {
-        p->vma[i].addr += length;
-        p->vma[i].len -= length;
-        break;
-      }
-      // 2. 结束位置
-      if(addr + length == p->vma[i].addr + p->vma[i].len) {
-        p->vma[i].len -= length;
-        break;
-      }
-    }
-  }
-  if(i == NVMA)
+  // 范围可以横跨多个VMA，也可以在一个VMA的中间，这时要把它拆成两个；
+  // 拆分要用的vm_area先分配好，免得取消了一部分映射后才失败
+  v = vma_next(p, addr);
+  if(v == 0 || v->addr >= end)
+    return -1;
+  if(v->addr < addr && v->addr + v->len > end && (nv = vma_alloc()) == 0)
     return -1;
 
-  // 将MAP_SHARED页面写回文件系统
-  if(p->vma[i].flags == MAP_SHARED && (p->vma[i].prot & PROT_WRITE) != 0) {
-    filewrite(p->vma[i].vfile, addr, length);
-  }
-
-  // 判断此页面是否存在映射
-  uvmunmap(p->pagetable, addr, length / PGSIZE, 1);
-
-  // 当前VMA中全部映射都被取消
-  if(p->vma[i].len == 0) {
-    fileclose(p->vma[i].vfile);
-    p->vma[i].used = 0;
+  for(; v && v->addr < end; v = next) {
+    next = v->next;
+    uint64 s = v->addr > addr ? v->addr : addr;
+    uint64 e = v->addr + v->len < end ? v->addr + v->len : end;
+
+    // 将MAP_SHARED中被写过的页面写回文件系统
+    vmawriteback(v, s, e - s);
+    uvmunmap(p->pagetable, s, (e - s) / PGSIZE, 1);
+
+    if(s == v->addr && e == v->addr + v->len) {
+      // 当前VMA中全部映射都被取消
+      vma_remove(p, v);
+      fileclose(v->vfile);
+      vma_free(v);
+    } else if(s == v->addr) {
+      vma_trim(v, e, v->addr + v->len);
+    } else if(e == v->addr + v->len) {
+      vma_trim(v, v->addr, s);
+    } else {
+      vma_split(p, v, e, nv);
+      vma_trim(v, v->addr, s);
+    }
   }
 
   return 0;
 }
 
 /**
- * @brief mmap_handler 处理mmap惰性分配导致的页面错误
+ * @brief mmap_handler 处理mmap惰性分配、exec按需调页和写时复制导致的页面错误
  * @param va 页面故障虚拟地址
- * @param cause 页面故障原因
+ * @param cause 页面故障原因：12取指，13读，15写
  * @return 0成功，-1失败
  */
-int mmap_handler(int va, int cause) {
-  int i;
+int mmap_handler(uint64 va, int cause) {
   struct proc* p = myproc();
-  // 根据地址查找属于哪一个VMA
-  for(i = 0; i < NVMA; ++i) {
-    if(p->vma[i].used && p->vma[i].addr <= va && va <= p->vma[i].addr + p->vma[i].len - 1) {
-      // vma使用过 && va在vma的合法地址段
-      break;
-    }
-  }
-  if(i == NVMA) // 没找到vma
+  // 根据地址在AVL树中查找属于哪一个VMA
+  struct vm_area *v = vma_find(p, va);
+  if(v == 0) // 没找到vma
     return -1;
 
   int pte_flags = PTE_U;
-  if(p->vma[i].prot & PROT_READ) pte_flags |= PTE_R;
-  if(p->vma[i].prot & PROT_WRITE) pte_flags |= PTE_W;
-  if(p->vma[i].prot & PROT_EXEC) pte_flags |= PTE_X;
+  if(v->prot & PROT_READ) pte_flags |= PTE_R;
+  if(v->prot & PROT_WRITE) pte_flags |= PTE_W;
+  if(v->prot & PROT_EXEC) pte_flags |= PTE_X;
 
 
-  struct file* vf = p->vma[i].vfile;
+  struct file* vf = v->vfile;
+  // 取指导致的页面错误
+  if(cause == 12 && (v->prot & PROT_EXEC) == 0) return -1;
   // 读导致的页面错误
   if(cause == 13 && vf->readable == 0) return -1;
-  // 写导致的页面错误
-  if(cause == 15 && vf->writable == 0) return -1;
+  // 写导致的页面错误：映射本身要可写；MAP_PRIVATE的写不会写回文件，
+  // 所以只有MAP_SHARED要求文件可写（exec的段就是只读文件的私有映射）
+  if(cause == 15 && ((v->prot & PROT_WRITE) == 0 ||
+                     (v->flags == MAP_SHARED && vf->writable == 0)))
+    return -1;
+
+  // 页已经映射了：只可能是写一个写时复制的页，给本进程复制一份
+  pte_t *pte = walk(p->pagetable, PGROUNDDOWN(va), 0);
+  if(pte && (*pte & PTE_V)) {
+    if(cause != 15)
+      return -1;
+    return cow_alloc(p->pagetable, va);
+  }
+
+  // 计算当前页面读取文件的偏移量
+  // 要按顺序读读取，例如内存页面A,B和文件块a,b
+  // 则A读取a，B读取b，而不能A读取b，B读取a
+  uint64 pgoff = PGROUNDDOWN(va - v->addr);
+
+  // 内核拿着这个inode的锁访问用户内存时（缓冲区映射着同一个文件）
+  // 再ilock会等自己，只能失败；fileread和filewrite事先已把缓冲区调入
+  if(pgoff < v->filesz && holdingsleep(&vf->ip->lock))
+    return -1;
+
+  // 整页都来自文件的页从页缓存中取，映射同一文件的进程共用一份：
+  // MAP_SHARED直接映射缓存页，大家看到彼此的写；
+  // MAP_PRIVATE（包括exec的段）只读映射，可写的标上PTE_COW，写时再复制
+  int shared = v->flags == MAP_SHARED;
+  if(pgoff + PGSIZE <= v->filesz) {
+    if(shared)
+      pte_flags |= PTE_SHARED;
+    else if(pte_flags & PTE_W)
+      pte_flags = (pte_flags & ~PTE_W) | PTE_COW;
+    ilock(vf->ip);
+    char *cpa = pcget(vf->ip, v->offset + pgoff, shared);
+    iunlock(vf->ip);
+    if(cpa == 0)
+      return -1;
+    if(mappages(p->pagetable, PGROUNDDOWN(va), PGSIZE, (uint64)cpa, pte_flags) != 0) {
+      kfree(cpa);
+      return -1;
+    }
+    tlbflush(p->pagetable, PGROUNDDOWN(va), 1);
+    // 私有映射上的写：从缓存页复制一份，这样也能看到别人经MAP_SHARED还没写回的修改
+    if(cause == 15 && !shared)
+      return cow_alloc(p->pagetable, va);
+    return 0;
+  }
 
   void* pa = kalloc();
   if(pa == 0)
     return -1;
   memset(pa, 0, PGSIZE);
 
-  // 读取文件内容，先对inode上锁保证读取的原子性
-  ilock(vf->ip);//Lock the given inode.Reads the inode from disk if necessary.
-  // 计算当前页面读取文件的偏移量，实验中p->vma[i].offset总是0
-  // 要按顺序读读取，例如内存页面A,B和文件块a,b
-  // 则A读取a，B读取b，而不能A读取b，B读取a
-  int offset = p->vma[i].offset + PGROUNDDOWN(va - p->vma[i].addr);
-  int readbytes = readi(vf->ip, 0, (uint64)pa, offset, PGSIZE);
-  // 什么都没有读到
-  if(readbytes == 0) {
+  if(pgoff < v->filesz) {
+    uint n = v->filesz - pgoff < PGSIZE ? v->filesz - pgoff : PGSIZE;
+    // 读取文件内容，先对inode上锁保证读取的原子性
+    ilock(vf->ip);//Lock the given inode.Reads the inode from disk if necessary.
+    int readbytes = readi(vf->ip, 0, (uint64)pa, v->offset + pgoff, n);
     iunlock(vf->ip);
-    kfree(pa);
-    return -1;
+    // 什么都没有读到
+    if(readbytes == 0) {
+      kfree(pa);
+      return -1;
+    }
   }
-  iunlock(vf->ip);
+  // 超出filesz的页（exec的bss）保持全0
 
   // 添加页面映射
   if(mappages(p->pagetable, PGROUNDDOWN(va), PGSIZE, (uint64)pa, pte_flags) != 0) {
     kfree(pa);
     return -1;
   }
+  tlbflush(p->pagetable, PGROUNDDOWN(va), 1);
 
   return 0;
 }
+
+// Drop all of p's mappings: write back dirty shared pages,
+// free their pages and release their files. exit() calls this,
+// and so does exec() before it switches to the new image.
+void
+vmaclose(struct proc *p)
+{
+  // 映射的MAP_SHARED文件中的脏页写回
+  for(struct vm_area *v = p->vmalist; v; v = v->next)
+    vmawriteback(v, v->addr, v->len);
+  vma_drop(p);
+}
@@ -95,3 +95,11 @@ sys_uptime(void)
   release(&tickslock);
   return xticks;
 }
+
+// return how many blocks have been written
+// to the disk since start.
+uint64
+sys_diskwrites(void)
+{
+  return virtio_disk_nwrite();
+}
@@ -68,17 +68,14 @@ usertrap(void)
     syscall();
   } else if((which_dev = devintr()) != 0){
     // ok
-  } else if(r_scause() == 13 || r_scause() == 15){
-#ifdef LAB_MMAP//当进程第一次访问 file 的某段内容时，进程会先去memory中寻找是否有file对应的内容
-    // 此时找不到便发生缺页中断
-    // 读取产生页面故障的虚拟地址，并判断是否位于有效区间
+  } else if(r_scause() == 12 || r_scause() == 13 || r_scause() == 15){
+    //当进程第一次访问 file 的某段内容时，进程会先去memory中寻找是否有file对应的内容
+    // 此时找不到便发生缺页中断；exec的代码和数据段也是这样按需读入的
+    // 读取产生页面故障的虚拟地址，由mmap_handler在VMA树中判断是否位于有效区间
+    // 栈下面的保护页和没有映射的地址不属于任何VMA，mmap_handler会拒绝
     uint64 fault_va = r_stval();
-    if(PGROUNDUP(p->trapframe->sp) - 1 < fault_va && fault_va < p->sz) {
-      if(mmap_handler(r_stval(), r_scause()) != 0) p->killed = 1;
-    } 
-    else // 不在有效区间
+    if(mmap_handler(fault_va, r_scause()) != 0)
       p->killed = 1;
-#endif
   } 
   else {
     printf("usertrap(): unexpected scause %p pid=%d\n", r_scause(), p->pid);
@@ -132,7 +129,7 @@ usertrapret(void)
   w_sepc(p->trapframe->epc);
 
   // tell trampoline.S the user page table to switch to.
-  uint64 satp = MAKE_SATP(p->pagetable);
+  uint64 satp = usersatp(p);
 
   // jump to trampoline.S at the top of memory, which 
   // switches to the user page table, restores user registers,
@@ -70,6 +70,8 @@ static struct disk {
   struct virtio_blk_req ops[NUM];
   
   struct spinlock vdisk_lock;
+
+  uint64 nwrite;   // 写过的块数，diskwrites()用
   
 } __attribute__ ((aligned (PGSIZE))) disk;
 
@@ -206,6 +208,8 @@ virtio_disk_rw(struct buf *b, int write)
   uint64 sector = b->blockno * (BSIZE / 512);
 
   acquire(&disk.vdisk_lock);
+  if(write)
+    disk.nwrite++;
 
   // the spec's Section 5.2 says that legacy block operations use
   // three descriptors: one for type/reserved/sector, one for the
@@ -313,3 +317,14 @@ virtio_disk_intr()
 
   release(&disk.vdisk_lock);
 }
+
+uint64
+virtio_disk_nwrite(void)
+{
+  uint64 n;
+
+  acquire(&disk.vdisk_lock);
+  n = disk.nwrite;
+  release(&disk.vdisk_lock);
+  return n;
+}
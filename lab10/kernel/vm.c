@@ -5,6 +5,8 @@
 #include "riscv.h"
 #include "defs.h"
 #include "fs.h"
+#include "spinlock.h"
+#include "proc.h"
 
 /*
  * the kernel's page table.
@@ -105,13 +107,23 @@ walkaddr(pagetable_t pagetable, uint64 va)
 {
   pte_t *pte;
   uint64 pa;
+  struct proc *p;
 
   if(va >= MAXVA)
     return 0;
 
   pte = walk(pagetable, va, 0);
-  if(pte == 0)
-    return 0;
+  if(pte == 0 || (*pte & PTE_V) == 0){
+    // copyin/copyout的目标可能是还没读入的mmap页或exec的段。
+    // 读文件要睡眠，关着中断（持有自旋锁）时不行，
+    // 这样的调用者要先用uvmresident()让页面就位
+    p = myproc();
+    if(p == 0 || pagetable != p->pagetable || !intr_get())
+      return 0;
+    if(mmap_handler(va, 13) != 0)
+      return 0;
+    pte = walk(pagetable, va, 0);
+  }
   if((*pte & PTE_V) == 0)
     return 0;
   if((*pte & PTE_U) == 0)
@@ -173,7 +185,7 @@ uvmunmap(pagetable_t pagetable, uint64 va, uint64 npages, int do_free)
 
   for(a = va; a < va + npages*PGSIZE; a += PGSIZE){
     if((pte = walk(pagetable, a, 0)) == 0)
-      panic("uvmunmap: walk");
+      continue;  // 从未访问过的mmap页或exec的段，连页表页都还没有
     if((*pte & PTE_V) == 0)
       continue;
       //panic("uvmunmap: not mapped");
@@ -185,6 +197,50 @@ uvmunmap(pagetable_t pagetable, uint64 va, uint64 npages, int do_free)
     }
     *pte = 0;
   }
+  tlbflush(pagetable, va, npages);
+}
+
+// Fault in the user pages of [va, va+len) of the current
+// process. For callers that copy while holding a spinlock,
+// when copyin/copyout cannot read pages from a file: call
+// this before taking the lock. Returns -1 on a bad address.
+int
+uvmresident(pagetable_t pagetable, uint64 va, uint64 len)
+{
+  for(uint64 a = PGROUNDDOWN(va); a < va + len; a += PGSIZE)
+    if(walkaddr(pagetable, a) == 0)
+      return -1;
+  return 0;
+}
+
+// Give the process its own copy of the PTE_COW page at va and
+// make it writable. Does not sleep, so copyout() can call it
+// with a spinlock held. Returns 0 on success, -1 if va is not
+// a COW page or there is no memory.
+int
+cow_alloc(pagetable_t pagetable, uint64 va)
+{
+  pte_t *pte;
+  uint64 pa;
+  char *mem;
+
+  va = PGROUNDDOWN(va);
+  pte = walk(pagetable, va, 0);
+  if(pte == 0 || (*pte & PTE_V) == 0 || (*pte & PTE_COW) == 0)
+    return -1;
+  pa = PTE2PA(*pte);
+  if(pagerefs((void*)pa) == 1){
+    // 页缓存已经换出了这一页，别的进程也都复制走了，不用再复制
+    *pte = (*pte & ~PTE_COW) | PTE_W;
+  } else {
+    if((mem = kalloc()) == 0)
+      return -1;
+    memmove(mem, (char*)pa, PGSIZE);
+    *pte = PA2PTE(mem) | (PTE_FLAGS(*pte) & ~PTE_COW) | PTE_W;
+    kfree((void*)pa);
+  }
+  tlbflush(pagetable, va, 1);
+  return 0;
 }
 
 // create an empty user page table.
@@ -300,20 +356,37 @@ uvmfree(pagetable_t pagetable, uint64 sz)
 // frees any allocated pages on failure.
 int
 uvmcopy(pagetable_t old, pagetable_t new, uint64 sz)
+{
+  return uvmcopyrange(old, new, 0, sz);
+}
+
+// Like uvmcopy(), for the pages of [start, end), which must be
+// page aligned; fork() uses it for the mmap regions above sz.
+int
+uvmcopyrange(pagetable_t old, pagetable_t new, uint64 start, uint64 end)
 {
   pte_t *pte;
   uint64 pa, i;
   uint flags;
   char *mem;
 
-  for(i = 0; i < sz; i += PGSIZE){
+  for(i = start; i < end; i += PGSIZE){
     if((pte = walk(old, i, 0)) == 0)
-      panic("uvmcopy: pte should exist");
+      continue;  // 子进程同样等到访问时再从文件读入
     if((*pte & PTE_V) == 0)
       continue;
       //panic("uvmcopy: page not present");
     pa = PTE2PA(*pte);
     flags = PTE_FLAGS(*pte);
+    // 只读的用户页（页缓存中的页，包括写时复制的）和MAP_SHARED的页直接共享，
+    // 写时复制的页谁要写再复制
+    if((flags & PTE_W) == 0 || (flags & PTE_SHARED)){
+      // 父进程写过的页由父进程写回，子进程的PTE从干净开始
+      if(mappages(new, i, PGSIZE, pa, flags & ~(PTE_A | PTE_D)) != 0)
+        goto err;
+      incr((void*)pa);
+      continue;
+    }
     if((mem = kalloc()) == 0)
       goto err;
     memmove(mem, (char*)pa, PGSIZE);
@@ -325,7 +398,7 @@ uvmcopy(pagetable_t old, pagetable_t new, uint64 sz)
   return 0;
 
  err:
-  uvmunmap(new, 0, i / PGSIZE, 1);
+  uvmunmap(new, start, (i - start) / PGSIZE, 1);
   return -1;
 }
 
@@ -349,12 +422,23 @@ int
 copyout(pagetable_t pagetable, uint64 dstva, char *src, uint64 len)
 {
   uint64 n, va0, pa0;
+  pte_t *pte;
 
   while(len > 0){
     va0 = PGROUNDDOWN(dstva);
     pa0 = walkaddr(pagetable, va0);
     if(pa0 == 0)
       return -1;
+    // 不能直接写写时复制的页，先给本进程复制一份；
+    // 这不会睡眠，持有自旋锁时也可以
+    pte = walk(pagetable, va0, 0);
+    if((*pte & PTE_W) == 0){
+      if(cow_alloc(pagetable, va0) != 0)
+        return -1;
+      pa0 = PTE2PA(*pte);
+    }
+    // 经物理地址写，硬件不会置PTE_D，要自己置上，munmap时才会写回
+    *pte |= PTE_D;
     n = PGSIZE - (dstva - va0);
     if(n > len)
       n = len;
@@ -0,0 +1,391 @@
+// Per-process virtual memory areas.
+//
+// Each mmap() region and each exec() segment of a process is a
+// struct vm_area. A process's areas never overlap. They sit in
+// an AVL tree keyed by address, so a page fault finds its area
+// in O(log n), and on a list sorted by address, so that the
+// neighbours of an area are at hand for merging, splitting and
+// placement. Only the process itself (or fork() and exec() on
+// its behalf) touches its areas, so they need no lock.
+//
+// struct vm_area comes from a free list that is refilled a page
+// at a time from kalloc(). Pages on it are never given back.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "fs.h"
+#include "sleeplock.h"
+#include "file.h"
+#include "defs.h"
+
+struct {
+  struct spinlock lock;
+  struct vm_area *free;  // linked through next
+} vmamem;
+
+void
+vmainit(void)
+{
+  initlock(&vmamem.lock, "vma");
+}
+
+// Allocate a zeroed vm_area. Returns 0 if out of memory.
+struct vm_area *
+vma_alloc(void)
+{
+  struct vm_area *v;
+  char *pa;
+
+  acquire(&vmamem.lock);
+  if(vmamem.free == 0){
+    release(&vmamem.lock);
+    if((pa = kalloc()) == 0)
+      return 0;
+    acquire(&vmamem.lock);
+    for(v = (struct vm_area*)pa; v + 1 <= (struct vm_area*)(pa + PGSIZE); v++){
+      v->next = vmamem.free;
+      vmamem.free = v;
+    }
+  }
+  v = vmamem.free;
+  vmamem.free = v->next;
+  release(&vmamem.lock);
+  memset(v, 0, sizeof(*v));
+  return v;
+}
+
+void
+vma_free(struct vm_area *v)
+{
+  acquire(&vmamem.lock);
+  v->next = vmamem.free;
+  vmamem.free = v;
+  release(&vmamem.lock);
+}
+
+static int
+height(struct vm_area *t)
+{
+  return t ? t->height : 0;
+}
+
+static void
+fixheight(struct vm_area *t)
+{
+  int hl = height(t->left), hr = height(t->right);
+
+  t->height = (hl > hr ? hl : hr) + 1;
+}
+
+static struct vm_area *
+rotateright(struct vm_area *t)
+{
+  struct vm_area *l = t->left;
+
+  t->left = l->right;
+  l->right = t;
+  fixheight(t);
+  fixheight(l);
+  return l;
+}
+
+static struct vm_area *
+rotateleft(struct vm_area *t)
+{
+  struct vm_area *r = t->right;
+
+  t->right = r->left;
+  r->left = t;
+  fixheight(t);
+  fixheight(r);
+  return r;
+}
+
+// Restore the AVL property at t, whose subtrees are balanced
+// and differ in height by at most 2. Returns the new root.
+static struct vm_area *
+balance(struct vm_area *t)
+{
+  fixheight(t);
+  if(height(t->left) > height(t->right) + 1){
+    if(height(t->left->left) < height(t->left->right))
+      t->left = rotateleft(t->left);
+    return rotateright(t);
+  }
+  if(height(t->right) > height(t->left) + 1){
+    if(height(t->right->right) < height(t->right->left))
+      t->right = rotateright(t->right);
+    return rotateleft(t);
+  }
+  return t;
+}
+
+static struct vm_area *
+treeinsert(struct vm_area *t, struct vm_area *v)
+{
+  if(t == 0){
+    v->left = v->right = 0;
+    v->height = 1;
+    return v;
+  }
+  if(v->addr < t->addr)
+    t->left = treeinsert(t->left, v);
+  else
+    t->right = treeinsert(t->right, v);
+  return balance(t);
+}
+
+// Unlink the leftmost node of t into *min.
+static struct vm_area *
+treeremovemin(struct vm_area *t, struct vm_area **min)
+{
+  if(t->left == 0){
+    *min = t;
+    return t->right;
+  }
+  t->left = treeremovemin(t->left, min);
+  return balance(t);
+}
+
+static struct vm_area *
+treeremove(struct vm_area *t, struct vm_area *v)
+{
+  struct vm_area *m;
+
+  if(t == 0)
+    panic("vma_remove");
+  if(v->addr < t->addr){
+    t->left = treeremove(t->left, v);
+  } else if(v->addr > t->addr){
+    t->right = treeremove(t->right, v);
+  } else {
+    if(t != v)
+      panic("vma_remove: overlap");
+    if(t->right == 0)
+      return t->left;
+    t->right = treeremovemin(t->right, &m);
+    m->left = t->left;
+    m->right = t->right;
+    return balance(m);
+  }
+  return balance(t);
+}
+
+// The lowest area of p that ends above va, or 0.
+struct vm_area *
+vma_next(struct proc *p, uint64 va)
+{
+  struct vm_area *t, *v = 0;
+
+  for(t = p->vmaroot; t; ){
+    if(t->addr + t->len > va){
+      v = t;
+      t = t->left;
+    } else {
+      t = t->right;
+    }
+  }
+  return v;
+}
+
+// The area of p that contains va, or 0.
+struct vm_area *
+vma_find(struct proc *p, uint64 va)
+{
+  struct vm_area *v = vma_next(p, va);
+
+  if(v && v->addr <= va)
+    return v;
+  return 0;
+}
+
+// The highest area of p, or 0.
+static struct vm_area *
+vma_last(struct proc *p)
+{
+  struct vm_area *t = p->vmaroot;
+
+  while(t && t->right)
+    t = t->right;
+  return t;
+}
+
+// Add v to p without merging. v must not overlap other areas.
+static void
+link(struct proc *p, struct vm_area *v)
+{
+  struct vm_area *next = vma_next(p, v->addr);
+
+  v->prev = next ? next->prev : vma_last(p);
+  v->next = next;
+  if(v->prev)
+    v->prev->next = v;
+  else
+    p->vmalist = v;
+  if(next)
+    next->prev = v;
+  p->vmaroot = treeinsert(p->vmaroot, v);
+  p->nvma++;
+}
+
+// Take v out of p. The caller frees it.
+void
+vma_remove(struct proc *p, struct vm_area *v)
+{
+  p->vmaroot = treeremove(p->vmaroot, v);
+  if(v->prev)
+    v->prev->next = v->next;
+  else
+    p->vmalist = v->next;
+  if(v->next)
+    v->next->prev = v->prev;
+  v->prev = v->next = 0;
+  p->nvma--;
+}
+
+// Can b, which lies just above a, become part of a? They must
+// map the same file the same way, with b's file bytes following
+// a's, and a must come from the file all the way to its end.
+static int
+mergeable(struct vm_area *a, struct vm_area *b)
+{
+  return a->addr + a->len == b->addr && a->vfile == b->vfile &&
+         a->prot == b->prot && a->flags == b->flags &&
+         a->offset + a->len == b->offset && a->filesz == a->len;
+}
+
+// Grow a over b, which lies just above it, and free b.
+static void
+merge(struct proc *p, struct vm_area *a, struct vm_area *b)
+{
+  vma_remove(p, b);
+  a->filesz = a->len + b->filesz;
+  a->len += b->len;
+  // a还引用着同一个文件，这里只会减引用计数，不会睡眠
+  fileclose(b->vfile);
+  vma_free(b);
+}
+
+// Add the new area v to p, merging it with its neighbours when
+// they are compatible, in which case v is freed.
+void
+vma_insert(struct proc *p, struct vm_area *v)
+{
+  struct vm_area *prev;
+
+  link(p, v);
+  if(v->next && mergeable(v, v->next))
+    merge(p, v, v->next);
+  if((prev = v->prev) != 0 && mergeable(prev, v))
+    merge(p, prev, v);
+}
+
+// Shrink v to [start, end), which must lie within it. Dropping
+// a head moves the file offset along; the tree order holds
+// because v still does not overlap its neighbours.
+void
+vma_trim(struct vm_area *v, uint64 start, uint64 end)
+{
+  uint64 n = start - v->addr;
+
+  v->addr = start;
+  v->offset += n;
+  v->filesz = v->filesz > n ? v->filesz - n : 0;
+  v->len = end - start;
+  if(v->filesz > v->len)
+    v->filesz = v->len;
+}
+
+// Split v at va, which lies strictly inside it: v keeps the
+// part below va and nv, a fresh area, gets the rest.
+void
+vma_split(struct proc *p, struct vm_area *v, uint64 va, struct vm_area *nv)
+{
+  uint64 end = v->addr + v->len;
+
+  *nv = *v;
+  nv->vfile = filedup(v->vfile);
+  vma_trim(nv, va, end);
+  vma_trim(v, v->addr, va);
+  link(p, nv);
+}
+
+// Is [va, va+len) free of areas?
+static int
+vma_isfree(struct proc *p, uint64 va, uint64 len)
+{
+  struct vm_area *v = vma_next(p, va);
+
+  return v == 0 || v->addr >= va + len;
+}
+
+// Choose where to put a new mapping of len bytes: at hint if
+// that range is free, otherwise in the highest gap below
+// MMAPTOP that fits. Mappings stay above p->sz, where sbrk()
+// grows the heap. Returns 0 if there is no room.
+uint64
+vma_place(struct proc *p, uint64 hint, uint64 len)
+{
+  struct vm_area *v;
+  uint64 lo = PGROUNDUP(p->sz), hi = MMAPTOP;
+
+  if(len == 0 || len > MMAPTOP)
+    return 0;
+  if(hint && hint % PGSIZE == 0 && hint >= lo && hint <= MMAPTOP - len &&
+     vma_isfree(p, hint, len))
+    return hint;
+
+  // 从最高的VMA往下找第一个放得下的空隙
+  for(v = vma_last(p); v && v->addr + v->len > lo; v = v->prev){
+    if(v->addr + v->len <= hi - len)
+      break;
+    hi = v->addr;
+    if(hi < lo + len)
+      return 0;
+  }
+  if(hi < lo + len)
+    return 0;
+  return hi - len;
+}
+
+// Give np a copy of each of p's areas, for fork(). Pages of the
+// areas above p->sz are shared or copied as uvmcopy() does for
+// the memory below it. Returns -1 on failure; np keeps the
+// areas it got so far, for vma_drop().
+int
+vma_dup(struct proc *p, struct proc *np)
+{
+  struct vm_area *v, *nv;
+
+  for(v = p->vmalist; v; v = v->next){
+    if((nv = vma_alloc()) == 0)
+      return -1;
+    *nv = *v;
+    nv->vfile = filedup(v->vfile);
+    link(np, nv);
+    if(v->addr >= p->sz &&
+       uvmcopyrange(p->pagetable, np->pagetable, v->addr, v->addr + v->len) < 0)
+      return -1;
+  }
+  return 0;
+}
+
+// Unmap and free all of p's areas without writing anything back.
+// fileclose() may sleep, unless other references keep the files
+// open, as they do on fork()'s failure path.
+void
+vma_drop(struct proc *p)
+{
+  struct vm_area *v;
+
+  while((v = p->vmalist) != 0){
+    vma_remove(p, v);
+    uvmunmap(p->pagetable, v->addr, v->len / PGSIZE, 1);
+    fileclose(v->vfile);
+    vma_free(v);
+  }
+}
@@ -199,6 +199,30 @@ mmap_test(void)
     err("munmap (4)");
 
   printf("test not-mapped unmap: OK\n");
+
+  printf("test read/write own mapping\n");
+
+  // the buffers of read() and write() are pages of a mapping of
+  // the same file that have not been touched yet, so the kernel
+  // faults them in while it is reading or writing that file.
+  if ((fd = open(f, O_RDWR)) == -1)
+    err("open");
+  p = mmap(0, PGSIZE*2, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (p == MAP_FAILED)
+    err("mmap (4)");
+  if (write(fd, p, PGSIZE) != PGSIZE)
+    err("write from own mapping");
+  if (read(fd, p + PGSIZE, PGSIZE/2) != PGSIZE/2)
+    err("read into own mapping");
+  for (i = 0; i < PGSIZE + (PGSIZE/2); i++)
+    if (p[i] != 'Z')
+      err("own mapping mismatch");
+  if (munmap(p, PGSIZE*2) == -1)
+    err("munmap (5)");
+  if (close(fd) == -1)
+    err("close");
+
+  printf("test read/write own mapping: OK\n");
     
   printf("test mmap two files\n");
   
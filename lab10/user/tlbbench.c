@@ -0,0 +1,45 @@
+#include "kernel/param.h"
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/riscv.h"
+#include "user/user.h"
+
+// 测量陷入内核的开销：空系统调用循环，以及每次系统调用之间
+// 重新访问一组页面的循环。每次进出内核都刷新TLB时，后者每页都要重新遍历页表；
+// 有ASID时用户态的TLB表项可以跨过系统调用保留下来。
+
+#define NCALL  200000   // 空系统调用次数
+#define NPAGE  32       // 每轮访问的页数，要能放进TLB
+#define NROUND 20000    // 访问轮数
+
+char buf[NPAGE * PGSIZE];
+
+int
+main(int argc, char *argv[])
+{
+  int t0, t1, t2;
+  volatile char *p = buf;
+  int sum = 0;
+
+  for(int i = 0; i < NPAGE; i++)
+    p[i * PGSIZE] = i;
+
+  t0 = uptime();
+  for(int i = 0; i < NCALL; i++)
+    getpid();
+  t1 = uptime();
+  for(int r = 0; r < NROUND; r++){
+    for(int i = 0; i < NPAGE; i++)
+      sum += p[i * PGSIZE];
+    getpid();
+  }
+  t2 = uptime();
+
+  if(sum != NROUND * (NPAGE * (NPAGE - 1) / 2)){
+    printf("tlbbench: bad data\n");
+    exit(-1);
+  }
+  printf("tlbbench: %d null syscalls in %d ticks\n", NCALL, t1 - t0);
+  printf("tlbbench: %d rounds of %d pages + syscall in %d ticks\n", NROUND, NPAGE, t2 - t1);
+  exit(0);
+}
@@ -25,6 +25,7 @@ int sleep(int);
 int uptime(void);
 void* mmap(void*, int, int, int, int, int);
 int munmap(void*, int);
+int diskwrites(void);
 
 // ulib.c
 int stat(const char*, struct stat*);
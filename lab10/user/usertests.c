@@ -7,6 +7,7 @@
 #include "kernel/syscall.h"
 #include "kernel/memlayout.h"
 #include "kernel/riscv.h"
+#include "kernel/elf.h"
 
 //
 // Tests xv6 system calls.  usertests without arguments runs them all
@@ -2607,6 +2608,366 @@ sbrklast(char *s)
     exit(1);
 }
 
+// fork and exec args[0] n times with stdout and stderr
+// closed, and return the number of ticks that took.
+int
+exectime(char *s, char **args, int n, int xexpect)
+{
+  int t0 = uptime();
+  for(int i = 0; i < n; i++){
+    int pid = fork();
+    if(pid < 0){
+      printf("%s: fork failed\n", s);
+      exit(1);
+    }
+    if(pid == 0){
+      close(1);
+      close(2);
+      exec(args[0], args);
+      exit(77);
+    }
+    int xstatus;
+    wait(&xstatus);
+    if(xstatus != xexpect){
+      printf("%s: %s exited with %d\n", s, args[0], xstatus);
+      exit(1);
+    }
+  }
+  return uptime() - t0;
+}
+
+// exec latency for a small binary (echo) and a large one
+// (usertests itself, which just prints its usage). exec only
+// reads pages in as they are touched, so the large binary
+// should not cost much more than the small one.
+void
+execlatency(char *s)
+{
+  char *small[] = { "echo", 0 };
+  char *large[] = { "usertests", "-x", 0 };
+  int n = 100;
+
+  int ts = exectime(s, small, n, 0);
+  int tl = exectime(s, large, n, 1);
+  printf("%s: %d execs: echo %d ticks, usertests %d ticks\n", s, n, ts, tl);
+}
+
+// exec() shares program pages through a cache keyed by inode,
+// and writing the file must update them. copy grep, run it (it
+// prints its usage) so that its pages are cached, zero its code,
+// and check that the next run crashes instead of running the
+// cached code.
+void
+textinval(char *s)
+{
+  char *args[] = { "textinval.x", 0 };
+  struct stat st;
+  struct elfhdr elf;
+  struct proghdr ph;
+  char *img;
+  int fd, i;
+
+  if((fd = open("grep", O_RDONLY)) < 0 || fstat(fd, &st) < 0){
+    printf("%s: cannot open grep\n", s);
+    exit(1);
+  }
+  if((img = malloc(st.size)) == 0 || read(fd, img, st.size) != st.size){
+    printf("%s: cannot read grep\n", s);
+    exit(1);
+  }
+  close(fd);
+
+  fd = open(args[0], O_CREATE|O_WRONLY|O_TRUNC);
+  if(fd < 0 || write(fd, img, st.size) != st.size){
+    printf("%s: cannot write %s\n", s, args[0]);
+    exit(1);
+  }
+  close(fd);
+  exectime(s, args, 1, 1);
+
+  // 把所有可加载段中来自文件的部分清零，ELF头和程序头除外
+  memmove(&elf, img, sizeof(elf));
+  uint64 hdr = elf.phoff + elf.phnum * sizeof(ph);
+  for(i = 0; i < elf.phnum; i++){
+    memmove(&ph, img + elf.phoff + i * sizeof(ph), sizeof(ph));
+    uint64 from = ph.off > hdr ? ph.off : hdr;
+    if(ph.type == ELF_PROG_LOAD && ph.off + ph.filesz > from)
+      memset(img + from, 0, ph.off + ph.filesz - from);
+  }
+  fd = open(args[0], O_WRONLY|O_TRUNC);
+  if(fd < 0 || write(fd, img, st.size) != st.size){
+    printf("%s: cannot rewrite %s\n", s, args[0]);
+    exit(1);
+  }
+  close(fd);
+  exectime(s, args, 1, -1);
+
+  unlink(args[0]);
+  free(img);
+}
+
+// MAP_SHARED mappings of a file share its page-cache pages, so
+// a store by one process is seen by another at once, while a
+// MAP_PRIVATE mapping gets its own copy on its first store and
+// never changes the file.
+void
+mmapshare(char *s)
+{
+  int fd, fds[2], pid, xstatus;
+  char *sh, *pv, c;
+
+  memset(buf, 'a', PGSIZE);
+  fd = open("mmapshare", O_CREATE|O_RDWR);
+  if(fd < 0 || write(fd, buf, PGSIZE) != PGSIZE){
+    printf("%s: cannot create file\n", s);
+    exit(1);
+  }
+  close(fd);
+  if((fd = open("mmapshare", O_RDWR)) < 0){
+    printf("%s: cannot open file\n", s);
+    exit(1);
+  }
+  sh = mmap(0, PGSIZE, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+  pv = mmap(0, PGSIZE, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, 0);
+  if(sh == (char*)-1 || pv == (char*)-1){
+    printf("%s: mmap failed\n", s);
+    exit(1);
+  }
+  if(sh[0] != 'a' || pv[0] != 'a'){
+    printf("%s: wrong contents\n", s);
+    exit(1);
+  }
+
+  // 子进程经继承来的共享映射写，父进程不等它munmap就应看到
+  if(pipe(fds) != 0){
+    printf("%s: pipe failed\n", s);
+    exit(1);
+  }
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    sh[0] = 'b';
+    write(fds[1], "x", 1);
+    exit(0);
+  }
+  if(read(fds[0], &c, 1) != 1 || sh[0] != 'b'){
+    printf("%s: shared store not seen\n", s);
+    exit(1);
+  }
+  pv[1] = 'c';
+  if(sh[1] != 'a' || pv[1] != 'c'){
+    printf("%s: private store reached the shared page\n", s);
+    exit(1);
+  }
+  wait(&xstatus);
+  close(fds[0]);
+  close(fds[1]);
+  if(xstatus != 0)
+    exit(1);
+
+  munmap(sh, PGSIZE);
+  munmap(pv, PGSIZE);
+  close(fd);
+  fd = open("mmapshare", O_RDONLY);
+  if(fd < 0 || read(fd, buf, 2) != 2 || buf[0] != 'b' || buf[1] != 'a'){
+    printf("%s: file has wrong contents\n", s);
+    exit(1);
+  }
+  close(fd);
+  unlink("mmapshare");
+}
+
+// munmap() writes back only the pages of a MAP_SHARED mapping
+// that were written. map a large file, read every page, write
+// one, and count the disk writes that munmap() causes.
+#define WBPAGES 32
+void
+mmapwb(char *s)
+{
+  int fd, i, n;
+  char *p;
+  volatile char sum = 0;
+
+  memset(buf, 'a', PGSIZE);
+  fd = open("mmapwb", O_CREATE|O_RDWR);
+  if(fd < 0){
+    printf("%s: cannot create file\n", s);
+    exit(1);
+  }
+  for(i = 0; i < WBPAGES; i++){
+    if(write(fd, buf, PGSIZE) != PGSIZE){
+      printf("%s: write failed\n", s);
+      exit(1);
+    }
+  }
+  p = mmap(0, WBPAGES*PGSIZE, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+  if(p == (char*)-1){
+    printf("%s: mmap failed\n", s);
+    exit(1);
+  }
+  close(fd);
+  for(i = 0; i < WBPAGES; i++)
+    sum += p[i*PGSIZE];
+  p[5*PGSIZE + 7] = 'x';
+
+  n = diskwrites();
+  if(munmap(p, WBPAGES*PGSIZE) != 0){
+    printf("%s: munmap failed\n", s);
+    exit(1);
+  }
+  n = diskwrites() - n;
+  // 一页是PGSIZE/BSIZE个数据块，加上inode，经日志各写两次，再加两次日志头；
+  // 留些余量，但要远少于把整个文件写一遍
+  if(n == 0 || n > 2 * (2 * (PGSIZE/BSIZE + 1) + 2)){
+    printf("%s: munmap wrote %d blocks\n", s, n);
+    exit(1);
+  }
+
+  if((fd = open("mmapwb", O_RDONLY)) < 0){
+    printf("%s: cannot open file\n", s);
+    exit(1);
+  }
+  for(i = 0; i <= 5; i++){
+    if(read(fd, buf, PGSIZE) != PGSIZE || buf[6] != 'a' ||
+       buf[7] != (i == 5 ? 'x' : 'a')){
+      printf("%s: file has wrong contents\n", s);
+      exit(1);
+    }
+  }
+  close(fd);
+
+  // read() stores into a mapping through the kernel, which
+  // must mark the page dirty so that munmap() writes it back.
+  memset(buf, 'b', PGSIZE);
+  if((fd = open("mmapwb2", O_CREATE|O_RDWR)) < 0 ||
+     write(fd, buf, PGSIZE) != PGSIZE){
+    printf("%s: cannot create mmapwb2\n", s);
+    exit(1);
+  }
+  close(fd);
+  if((fd = open("mmapwb", O_RDWR)) < 0){
+    printf("%s: cannot open file\n", s);
+    exit(1);
+  }
+  p = mmap(0, WBPAGES*PGSIZE, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if(p == (char*)-1){
+    printf("%s: mmap failed\n", s);
+    exit(1);
+  }
+  if((fd = open("mmapwb2", O_RDONLY)) < 0 ||
+     read(fd, p + 2*PGSIZE, PGSIZE) != PGSIZE){
+    printf("%s: read into mapping failed\n", s);
+    exit(1);
+  }
+  close(fd);
+  if(munmap(p, WBPAGES*PGSIZE) != 0){
+    printf("%s: munmap failed\n", s);
+    exit(1);
+  }
+  if((fd = open("mmapwb", O_RDONLY)) < 0){
+    printf("%s: cannot open file\n", s);
+    exit(1);
+  }
+  for(i = 0; i <= 2; i++){
+    if(read(fd, buf, PGSIZE) != PGSIZE ||
+       buf[0] != (i == 2 ? 'b' : 'a') || buf[PGSIZE-1] != (i == 2 ? 'b' : 'a')){
+      printf("%s: read() into mapping not written back\n", s);
+      exit(1);
+    }
+  }
+  close(fd);
+  unlink("mmapwb2");
+  unlink("mmapwb");
+}
+
+// a process can hold hundreds of mappings, placed top-down
+// without overlapping, and munmap() can punch a hole in the
+// middle of one. page k of the file starts with the int k.
+#define NMANY 300
+void
+mmapmany(char *s)
+{
+  static char *many[NMANY];
+  int fd, i, pid, xstatus;
+  char *big;
+
+  fd = open("mmapmany", O_CREATE|O_RDWR);
+  if(fd < 0){
+    printf("%s: cannot create file\n", s);
+    exit(1);
+  }
+  for(i = 0; i < 8; i++){
+    memset(buf, 0, PGSIZE);
+    *(int*)buf = i;
+    if(write(fd, buf, PGSIZE) != PGSIZE){
+      printf("%s: write failed\n", s);
+      exit(1);
+    }
+  }
+
+  for(i = 0; i < NMANY; i++){
+    many[i] = mmap(0, PGSIZE, PROT_READ, MAP_PRIVATE, fd, (i % 8) * PGSIZE);
+    if(many[i] == (char*)-1){
+      printf("%s: mmap %d failed\n", s, i);
+      exit(1);
+    }
+  }
+  for(i = 0; i < NMANY; i++){
+    if(*(int*)many[i] != i % 8){
+      printf("%s: mapping %d has the wrong page\n", s, i);
+      exit(1);
+    }
+  }
+  for(i = 0; i < NMANY; i++){
+    if(munmap(many[i], PGSIZE) != 0){
+      printf("%s: munmap %d failed\n", s, i);
+      exit(1);
+    }
+  }
+
+  // 在8页映射的中间打一个2页的洞
+  big = mmap(0, 8*PGSIZE, PROT_READ, MAP_SHARED, fd, 0);
+  if(big == (char*)-1 || munmap(big + 3*PGSIZE, 2*PGSIZE) != 0){
+    printf("%s: cannot punch a hole\n", s);
+    exit(1);
+  }
+  for(i = 0; i < 8; i++){
+    if(i != 3 && i != 4 && *(int*)(big + i*PGSIZE) != i){
+      printf("%s: page %d wrong after munmap\n", s, i);
+      exit(1);
+    }
+  }
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    printf("%s: hole still mapped, read %d\n", s, *(int*)(big + 4*PGSIZE));
+    exit(0);
+  }
+  wait(&xstatus);
+  if(xstatus != -1)
+    exit(1);
+
+  // 按建议的地址把洞映射回去，和两边合并，再一次munmap整个范围
+  if(mmap(big + 3*PGSIZE, 2*PGSIZE, PROT_READ, MAP_SHARED, fd, 3*PGSIZE) != big + 3*PGSIZE ||
+     *(int*)(big + 4*PGSIZE) != 4){
+    printf("%s: cannot map the hole again\n", s);
+    exit(1);
+  }
+  if(munmap(big, 8*PGSIZE) != 0){
+    printf("%s: munmap failed\n", s);
+    exit(1);
+  }
+  close(fd);
+  unlink("mmapmany");
+}
+
 // does sbrk handle signed int32 wrap-around with
 // negative arguments?
 void
@@ -2881,6 +3242,11 @@ main(int argc, char *argv[])
     {iref, "iref"},
     {forktest, "forktest"},
     {bigdir, "bigdir"}, // slow
+    {execlatency, "execlatency"},
+    {textinval, "textinval"},
+    {mmapshare, "mmapshare"},
+    {mmapwb, "mmapwb"},
+    {mmapmany, "mmapmany"},
     { 0, 0},
   };
 
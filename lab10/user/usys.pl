@@ -37,4 +37,5 @@ entry("sbrk");
 entry("sleep");
 entry("uptime");
 entry("mmap");
-entry("munmap")
\ No newline at end of file
+entry("munmap");
+entry("diskwrites");
@@ -8,6 +8,7 @@ struct spinlock;
 struct sleeplock;
 struct stat;
 struct superblock;
+struct ukdata;
 
 // bio.c
 void            binit(void);
@@ -63,6 +64,7 @@ void            ramdiskrw(struct buf*);
 void*           kalloc(void);
 void            kfree(void *);
 void            kinit(void);
+uint64          kcount(void);
 
 // log.c
 void            initlog(int, struct superblock*);
@@ -104,6 +106,9 @@ void            yield(void);
 int             either_copyout(int user_dst, uint64 dst, void *src, uint64 len);
 int             either_copyin(void *dst, int user_src, uint64 src, uint64 len);
 void            procdump(void);
+void            wsupdate(struct proc*);
+void            wsreset(struct proc*);
+uint64          procnum(void);
 
 // swtch.S
 void            swtch(struct context*, struct context*);
@@ -144,6 +149,7 @@ extern uint     ticks;
 void            trapinit(void);
 void            trapinithart(void);
 extern struct spinlock tickslock;
+extern struct ukdata *ukdata;
 void            usertrapret(void);
 
 // uart.c
@@ -172,6 +178,8 @@ int             copyin(pagetable_t, char *, uint64, uint64);
 int             copyinstr(pagetable_t, char *, uint64, uint64);
 void            vmprint(pagetable_t, uint64);
 int             vm_pgaccess(pagetable_t, uint64);
+void            uvmage(pagetable_t, uint64, uchar**, uint);
+int             uvmpageage(pagetable_t, uint64, uchar**);
 
 // plic.c
 void            plicinit(void);
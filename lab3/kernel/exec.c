@@ -115,6 +115,7 @@ exec(char *path, char **argv)
   p->trapframe->epc = elf.entry;  // initial program counter = main
   p->trapframe->sp = sp; // initial stack pointer
   proc_freepagetable(oldpagetable, oldsz);
+  wsreset(p);
 
   if(p->pid==1) vmprint(p->pagetable, 0);
 
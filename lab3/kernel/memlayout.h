@@ -66,14 +66,37 @@
 //   fixed-size stack
 //   expandable heap
 //   ...
+//   UKDATA (shared by all processes, read-only)
 //   USYSCALL (shared with kernel)
 //   TRAPFRAME (p->trapframe, used by the trampoline)
 //   TRAMPOLINE (the same page as in the kernel)
 #define TRAPFRAME (TRAMPOLINE - PGSIZE)
 #ifdef LAB_PGTBL
 #define USYSCALL (TRAPFRAME - PGSIZE)
+#define UKDATA (USYSCALL - PGSIZE)
 
+// One per process. The kernel writes it only while the process
+// is in the kernel, so user code can read it without locking.
 struct usyscall {
-  int pid;  // Process ID
+  int pid;          // Process ID
+  int cpu;          // CPU the process last returned to user space on
+  uint64 nsyscall;  // system calls made
+  uint64 nintr;     // device and timer interrupts taken in user mode
+  uint64 nswitch;   // times the process gave up its CPU
+};
+
+#define UKDATA_VERSION 1
+
+// One page for the whole system, updated by clockintr() under a
+// seqlock: seq is odd while an update is in progress, so a reader
+// retries if seq was odd or changed while it copied the fields.
+// A reader that finds another version should use the system calls.
+struct ukdata {
+  uint seq;
+  uint version;     // UKDATA_VERSION
+  uint ticks;       // what uptime() returns
+  uint ncpu;        // NCPU
+  uint64 freemem;   // bytes of free memory, as of the last tick
+  uint64 nproc;     // processes in use, as of the last tick
 };
 #endif
@@ -11,3 +11,7 @@
 #define NBUF         (MAXOPBLOCKS*3)  // size of disk block cache
 #define FSSIZE       1000  // size of file system in blocks
 #define MAXPATH      128   // maximum file path name
+#define WSPERIOD     10    // ticks between working-set samples
+#define NWSPAGE      8     // pages of per-page ages, covering 128 MB of user memory
+#define WSAGEMAX     254   // oldest page age, in sampling periods
+#define WSNONE       255   // pgage() result for an address with no user page
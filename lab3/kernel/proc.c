@@ -118,6 +118,7 @@ allocproc(void)
 
 found:
   p->pid = allocpid();
+  p->wstick = ticks;
   p->state = USED;
 
   // Allocate a trapframe page.
@@ -133,6 +134,7 @@ found:
     release(&p->lock);
     return 0;
   }
+  memset(p->usyscall, 0, PGSIZE);
   p->usyscall->pid = p->pid;//为进程p的结构体初始化
 
   // An empty user page table.
@@ -164,6 +166,11 @@ freeproc(struct proc *p)
   if(p->usyscall)//根据提示，仿照前面的释放页表
     kfree((void*)p->usyscall);
   p->usyscall = 0;
+  for(int i = 0; i < NWSPAGE; i++){
+    if(p->wsage[i])
+      kfree((void*)p->wsage[i]);
+    p->wsage[i] = 0;
+  }
   if(p->pagetable)
     proc_freepagetable(p->pagetable, p->sz);
   p->pagetable = 0;
@@ -211,7 +218,17 @@ proc_pagetable(struct proc *p)
   //不加 PTE_U权限，PTE只能在特权模式下使用。
   if(mappages(pagetable, USYSCALL, PGSIZE,
               (uint64)(p->usyscall), PTE_R | PTE_U) < 0){
-    uvmunmap(pagetable, USYSCALL, 1, 0);//如果创建失败则要把前面页表建立的关系也重置掉
+    uvmunmap(pagetable, TRAPFRAME, 1, 0);//如果创建失败则要把前面页表建立的关系也重置掉
+    uvmunmap(pagetable, TRAMPOLINE, 1, 0);
+    uvmfree(pagetable, 0);
+    return 0;
+  }
+
+  // 所有进程共享同一个只读的UKDATA页
+  if(mappages(pagetable, UKDATA, PGSIZE,
+              (uint64)ukdata, PTE_R | PTE_U) < 0){
+    uvmunmap(pagetable, USYSCALL, 1, 0);
+    uvmunmap(pagetable, TRAPFRAME, 1, 0);
     uvmunmap(pagetable, TRAMPOLINE, 1, 0);
     uvmfree(pagetable, 0);
     return 0;
@@ -225,6 +242,7 @@ proc_pagetable(struct proc *p)
 void
 proc_freepagetable(pagetable_t pagetable, uint64 sz)
 {
+  uvmunmap(pagetable, UKDATA, 1, 0);
   uvmunmap(pagetable, USYSCALL, 1, 0);
   uvmunmap(pagetable, TRAMPOLINE, 1, 0);
   uvmunmap(pagetable, TRAPFRAME, 1, 0);
@@ -508,6 +526,7 @@ sched(void)
   if(intr_get())
     panic("sched interruptible");
 
+  p->usyscall->nswitch++;
   intena = mycpu()->intena;
   swtch(&p->context, &mycpu()->context);
   mycpu()->intena = intena;
@@ -648,6 +667,47 @@ either_copyin(void *dst, int user_src, uint64 src, uint64 len)
   }
 }
 
+// Bring p's page ages up to date with the sampling periods
+// that have passed since its last sample. Called on every trap
+// from user space, so only a running process is sampled; a
+// process that slept through several periods has all of its
+// used pages counted as used in the last one.
+void
+wsupdate(struct proc *p)
+{
+  uint n = (ticks - p->wstick) / WSPERIOD;
+
+  if(n == 0)
+    return;
+  p->wstick += n * WSPERIOD;
+  uvmage(p->pagetable, p->sz, p->wsage, n);
+}
+
+// Forget the page ages of p's old address space; exec() calls
+// this after installing the new one.
+void
+wsreset(struct proc *p)
+{
+  for(int i = 0; i < NWSPAGE; i++)
+    if(p->wsage[i])
+      memset(p->wsage[i], 0, PGSIZE);
+  p->wstick = ticks;
+}
+
+// Number of processes in use, for the UKDATA page.
+// 只是估计值，不加锁读state
+uint64
+procnum(void)
+{
+  struct proc *p;
+  uint64 n = 0;
+
+  for(p = proc; p < &proc[NPROC]; p++)
+    if(p->state != UNUSED)
+      n++;
+  return n;
+}
+
 // Print a process listing to console.  For debugging.
 // Runs when user types ^P on console.
 // No lock to avoid wedging a stuck machine further.
@@ -106,4 +106,6 @@ struct proc {
   struct file *ofile[NOFILE];  // Open files
   struct inode *cwd;           // Current directory
   char name[16];               // Process name (debugging)
+  uchar *wsage[NWSPAGE];       // 每个用户页自上次被访问以来经过的采样周期数
+  uint wstick;                 // 上次采样时的ticks
 };
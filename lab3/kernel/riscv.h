@@ -345,6 +345,7 @@ sfence_vma()
 #define PTE_X (1L << 3)
 #define PTE_U (1L << 4) // 1 -> user can access
 #define PTE_A (1L << 6)
+#define PTE_PGA (1L << 8) // RSW: accessed, but not yet reported by pgaccess
 
 //取出物理地址转换为对应的页表项
 // shift a physical address to the right place for a PTE.
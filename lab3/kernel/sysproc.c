@@ -106,6 +106,39 @@ sys_pgaccess(void)
 
   return 0;
 }
+
+// pgage(base, npages, ages): store the age of each of npages
+// pages from base in ages[], in WSPERIOD sampling periods since
+// the page was last used, or WSNONE if it is not mapped.
+// Returns the number of pages used in the last period.
+uint64
+sys_pgage(void)
+{
+  uint64 base, ages;
+  int npages, nhot = 0;
+  uchar buf[64];
+  struct proc *p = myproc();
+
+  if(argaddr(0, &base) < 0 || argint(1, &npages) < 0 || argaddr(2, &ages) < 0)
+    return -1;
+  if(npages < 0)
+    return -1;
+
+  wsupdate(p);
+  base = PGROUNDDOWN(base);
+  // 不限制页数，分批拷给用户
+  for(int i = 0; i < npages; i += sizeof(buf)){
+    int n = npages - i < sizeof(buf) ? npages - i : sizeof(buf);
+    for(int j = 0; j < n; j++){
+      buf[j] = uvmpageage(p->pagetable, base + (uint64)(i + j) * PGSIZE, p->wsage);
+      if(buf[j] == 0)
+        nhot++;
+    }
+    if(copyout(p->pagetable, ages + i, (char*)buf, n) < 0)
+      return -1;
+  }
+  return nhot;
+}
 #endif
 
 uint64
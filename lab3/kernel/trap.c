@@ -8,6 +8,7 @@
 
 struct spinlock tickslock;
 uint ticks;
+struct ukdata *ukdata;   // mapped read-only at UKDATA in every process
 
 extern char trampoline[], uservec[], userret[];
 
@@ -20,6 +21,11 @@ void
 trapinit(void)
 {
   initlock(&tickslock, "time");
+  if((ukdata = (struct ukdata*)kalloc()) == 0)
+    panic("trapinit: ukdata");
+  memset(ukdata, 0, PGSIZE);
+  ukdata->version = UKDATA_VERSION;
+  ukdata->ncpu = NCPU;
 }
 
 // set up to take exceptions and traps while in the kernel.
@@ -49,6 +55,9 @@ usertrap(void)
   
   // save user program counter.
   p->trapframe->epc = r_sepc();
+
+  // 每过一个采样周期，在进程进入内核时给它的页面计龄
+  wsupdate(p);
   
   if(r_scause() == 8){
     // system call
@@ -64,9 +73,10 @@ usertrap(void)
     // so don't enable until done with those registers.
     intr_on();
 
+    p->usyscall->nsyscall++;
     syscall();
   } else if((which_dev = devintr()) != 0){
-    // ok
+    p->usyscall->nintr++;
   } else {
     printf("usertrap(): unexpected scause %p pid=%d\n", r_scause(), p->pid);
     printf("            sepc=%p stval=%p\n", r_sepc(), r_stval());
@@ -105,6 +115,7 @@ usertrapret(void)
   p->trapframe->kernel_sp = p->kstack + PGSIZE; // process's kernel stack
   p->trapframe->kernel_trap = (uint64)usertrap;
   p->trapframe->kernel_hartid = r_tp();         // hartid for cpuid()
+  p->usyscall->cpu = cpuid();
 
   // set up the registers that trampoline.S's sret will use
   // to get to user space.
@@ -159,11 +170,27 @@ kerneltrap()
   w_sstatus(sstatus);
 }
 
+// Publish ticks and a sysinfo snapshot in the UKDATA page.
+// tickslock keeps writers apart; user-space readers see seq odd
+// or changed if they raced with this update, and try again.
+static void
+ukpublish(void)
+{
+  ukdata->seq++;
+  __sync_synchronize();
+  ukdata->ticks = ticks;
+  ukdata->freemem = kcount();
+  ukdata->nproc = procnum();
+  __sync_synchronize();
+  ukdata->seq++;
+}
+
 void
 clockintr()
 {
   acquire(&tickslock);
   ticks++;
+  ukpublish();
   wakeup(&ticks);
   release(&tickslock);
 }
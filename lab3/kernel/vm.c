@@ -474,9 +474,59 @@ vm_pgaccess(pagetable_t pagetable, uint64 va)
   pte = walk(pagetable, va, 0);//通过walk函数计算出虚拟地址对应的pagetable的入口地址
   if(pte == 0)
     return 0;
-  if((*pte & PTE_A) != 0){
-    *pte = *pte & (~PTE_A);//判断完以后将它的标志位清零
+  if((*pte & (PTE_A | PTE_PGA)) != 0){
+    *pte = *pte & ~(PTE_A | PTE_PGA);//判断完以后将它的标志位清零，包括采样时转存的
     return 1;
   }
   return 0;
+}
+
+// Age the user pages below sz by n sampling periods. A page
+// whose PTE_A is set was used since the last sample and gets
+// age 0; other pages get n periods older, up to WSAGEMAX.
+// PTE_A is cleared so the next sample sees new accesses, and
+// moved to PTE_PGA so that pgaccess() still reports it.
+// ages[] holds one byte per page and is allocated as needed.
+void
+uvmage(pagetable_t pagetable, uint64 sz, uchar **ages, uint n)
+{
+  uint64 va, i;
+  pte_t *pte;
+  uchar *a;
+
+  for(va = 0, i = 0; va < sz && i < NWSPAGE*PGSIZE; va += PGSIZE, i++){
+    if((pte = walk(pagetable, va, 0)) == 0 || (*pte & (PTE_V | PTE_U)) != (PTE_V | PTE_U))
+      continue;
+    if(ages[i / PGSIZE] == 0){
+      if((ages[i / PGSIZE] = kalloc()) == 0)
+        return;
+      memset(ages[i / PGSIZE], 0, PGSIZE);
+    }
+    a = &ages[i / PGSIZE][i % PGSIZE];
+    if(*pte & PTE_A){
+      *pte = (*pte & ~PTE_A) | PTE_PGA;
+      *a = 0;
+    } else if(*a + n < WSAGEMAX){
+      *a += n;
+    } else {
+      *a = WSAGEMAX;
+    }
+  }
+}
+
+// Return the age of the user page at va, or WSNONE if
+// there is no user page there.
+int
+uvmpageage(pagetable_t pagetable, uint64 va, uchar **ages)
+{
+  pte_t *pte;
+  uint64 i = va / PGSIZE;
+
+  if(va >= MAXVA || (pte = walk(pagetable, va, 0)) == 0 ||
+     (*pte & PTE_V) == 0 || (*pte & PTE_U) == 0)
+    return WSNONE;
+  // 本周期内访问过，还没被采样
+  if((*pte & PTE_A) || i >= NWSPAGE*PGSIZE || ages[i / PGSIZE] == 0)
+    return 0;
+  return ages[i / PGSIZE][i % PGSIZE];
 }
\ No newline at end of file
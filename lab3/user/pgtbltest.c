@@ -2,16 +2,19 @@
 #include "kernel/fcntl.h"
 #include "kernel/types.h"
 #include "kernel/riscv.h"
+#include "kernel/memlayout.h"
 #include "user/user.h"
 
 void ugetpid_test();
 void pgaccess_test();
+void ukdata_test();
 
 int
 main(int argc, char *argv[])
 {
   ugetpid_test();
   pgaccess_test();
+  ukdata_test();
   printf("pgtbltest: all tests succeeded\n");
   exit(0);
 }
@@ -41,7 +44,7 @@ ugetpid_test()
         exit(1);
       continue;
     }
-    if (getpid() != ugetpid())
+    if (sys_getpid() != ugetpid())
       err("missmatched PID");
     exit(0);
   }
@@ -68,3 +71,62 @@ pgaccess_test()
   free(buf);
   printf("pgaccess_test: OK\n");
 }
+
+#define NFAST 1000000
+#define NSLOW 10000
+
+void
+ukdata_test()
+{
+  struct ukdata d;
+  struct usyscall u0, u1;
+  int t0, t1, t2;
+
+  printf("ukdata_test starting\n");
+  testname = "ukdata_test";
+  if (ukinfo(&d) < 0)
+    err("unknown UKDATA version");
+  if (d.ncpu != NCPU || d.nproc < 2 || d.freemem == 0)
+    err("bad sysinfo snapshot");
+  if (ugetcpu() < 0 || ugetcpu() >= NCPU)
+    err("bad cpu");
+
+  // 两种方式读到的时间最多差一个tick
+  t0 = sys_uptime();
+  t1 = uptime();
+  t2 = sys_uptime();
+  if (t1 < t0 || t1 > t2)
+    err("uptime disagrees with the system call");
+
+  // 读页面不陷入内核，系统调用计数不变
+  uprocinfo(&u0);
+  for (int i = 0; i < 100; i++) {
+    getpid();
+    uptime();
+  }
+  uprocinfo(&u1);
+  if (u1.nsyscall != u0.nsyscall)
+    err("getpid or uptime trapped");
+  for (int i = 0; i < 100; i++)
+    sys_getpid();
+  uprocinfo(&u1);
+  if (u1.nsyscall != u0.nsyscall + 100)
+    err("wrong system call count");
+
+  // 读若干个tick，时间不能倒退（seqlock读到的值要一致）
+  t0 = uptime();
+  t1 = t0;
+  for (int i = 0; i < NFAST; i++) {
+    t2 = uptime();
+    if (t2 < t1)
+      err("uptime went backwards");
+    t1 = t2;
+  }
+  t1 = uptime();
+  for (int i = 0; i < NSLOW; i++)
+    sys_uptime();
+  t2 = uptime();
+  printf("ukdata_test: %d uptime() in %d ticks, %d sys_uptime() in %d ticks\n",
+         NFAST, t1 - t0, NSLOW, t2 - t1);
+  printf("ukdata_test: OK\n");
+}
@@ -148,4 +148,65 @@ ugetpid(void)
   struct usyscall *u = (struct usyscall *)USYSCALL;
   return u->pid;
 }
+
+// 本进程的页只在进程陷入内核时被修改，直接读即可
+int
+getpid(void)
+{
+  return ugetpid();
+}
+
+// The CPU this process was on when it last left the kernel.
+int
+ugetcpu(void)
+{
+  struct usyscall *u = (struct usyscall *)USYSCALL;
+  return u->cpu;
+}
+
+// Copy this process's counters.
+void
+uprocinfo(struct usyscall *u)
+{
+  *u = *(struct usyscall *)USYSCALL;
+}
+
+// Copy a consistent snapshot of the UKDATA page: retry while
+// the kernel is updating it (seq odd) or if it changed during
+// the copy. Returns -1 if the page has an unknown layout.
+int
+ukinfo(struct ukdata *d)
+{
+  volatile struct ukdata *k = (struct ukdata *)UKDATA;
+  uint seq;
+
+  if(k->version != UKDATA_VERSION)
+    return -1;
+  do{
+    while((seq = k->seq) & 1)
+      ;
+    __sync_synchronize();
+    *d = *(struct ukdata *)k;
+    __sync_synchronize();
+  } while(k->seq != seq);
+  return 0;
+}
+
+int
+uptime(void)
+{
+  volatile struct ukdata *k = (struct ukdata *)UKDATA;
+  uint seq, t;
+
+  if(k->version != UKDATA_VERSION)
+    return sys_uptime();
+  do{
+    while((seq = k->seq) & 1)
+      ;
+    __sync_synchronize();
+    t = k->ticks;
+    __sync_synchronize();
+  } while(k->seq != seq);
+  return t;
+}
 #endif
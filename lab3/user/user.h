@@ -1,6 +1,8 @@
 struct stat;
 struct rtcdate;
 struct sysinfo;
+struct usyscall;
+struct ukdata;
 
 // system calls
 int fork(void);
@@ -29,8 +31,14 @@ int connect(uint32, uint16, uint16);
 #endif
 #ifdef LAB_PGTBL
 int pgaccess(void *base, int len, void *mask);
+int pgage(void *base, int npages, uchar *ages);
 // usyscall region
 int ugetpid(void);
+int sys_getpid(void);
+int sys_uptime(void);
+int ugetcpu(void);
+void uprocinfo(struct usyscall*);
+int ukinfo(struct ukdata*);
 #endif
 
 // ulib.c
@@ -14,6 +14,23 @@ sub entry {
     print " ecall\n";
     print " ret\n";
 }
+
+# With LAB_PGTBL, ulib.c answers these from the UKDATA and
+# USYSCALL pages without trapping; the system calls are
+# still there as sys_<name>.
+sub fastentry {
+    my $name = shift;
+    print "#ifdef LAB_PGTBL\n";
+    print ".global sys_$name\n";
+    print "sys_${name}:\n";
+    print "#else\n";
+    print ".global $name\n";
+    print "${name}:\n";
+    print "#endif\n";
+    print " li a7, SYS_${name}\n";
+    print " ecall\n";
+    print " ret\n";
+}
 	
 entry("fork");
 entry("exit");
@@ -32,9 +49,10 @@ entry("link");
 entry("mkdir");
 entry("chdir");
 entry("dup");
-entry("getpid");
+fastentry("getpid");
 entry("sbrk");
 entry("sleep");
-entry("uptime");
+fastentry("uptime");
 entry("connect");
 entry("pgaccess");
+entry("pgage");
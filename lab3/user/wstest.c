@@ -0,0 +1,73 @@
+#include "kernel/param.h"
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/riscv.h"
+#include "user/user.h"
+
+// 分配NPAGE页并全部写一遍，之后几个采样周期里只访问前NHOT页，
+// 用pgage检查前NHOT页是热的、其余页变冷，并打印各年龄的页数直方图。
+
+#define NPAGE 64
+#define NHOT  8
+#define NROUND 4
+
+uchar ages[NPAGE];
+
+void
+fail(char *msg)
+{
+  printf("wstest: %s\n", msg);
+  exit(-1);
+}
+
+int
+main(int argc, char *argv[])
+{
+  char *buf;
+  int nhot, hist[WSAGEMAX + 1];
+
+  buf = sbrk(NPAGE * PGSIZE);
+  if(buf == (char*)-1)
+    fail("sbrk failed");
+  buf = (char*)PGROUNDUP((uint64)buf);
+  for(int i = 0; i < NPAGE - 1; i++)
+    buf[i * PGSIZE] = i;
+
+  for(int r = 0; r < NROUND; r++){
+    for(int i = 0; i < NHOT; i++)
+      buf[i * PGSIZE]++;
+    sleep(WSPERIOD + 1);
+  }
+  for(int i = 0; i < NHOT; i++)
+    buf[i * PGSIZE]++;
+
+  if((nhot = pgage(buf, NPAGE - 1, ages)) < 0)
+    fail("pgage failed");
+  for(int i = 0; i < NHOT; i++)
+    if(ages[i] != 0)
+      fail("hot page is not young");
+  for(int i = NHOT; i < NPAGE - 1; i++)
+    if(ages[i] == 0 || ages[i] == WSNONE)
+      fail("cold page is not old");
+  if(nhot != NHOT)
+    fail("wrong working-set size");
+
+  // 可以询问任意地址范围，没有映射的页报告WSNONE
+  if(pgage(buf + NPAGE * PGSIZE, NPAGE, ages) != 0)
+    fail("pgage beyond sz failed");
+  for(int i = 0; i < NPAGE; i++)
+    if(ages[i] != WSNONE)
+      fail("unmapped page has an age");
+  pgage(buf, NPAGE - 1, ages);
+
+  memset(hist, 0, sizeof(hist));
+  for(int i = 0; i < NPAGE - 1; i++)
+    hist[ages[i]]++;
+  printf("wstest: working set %d pages; age histogram:", nhot);
+  for(int a = 0; a <= WSAGEMAX; a++)
+    if(hist[a])
+      printf(" %d:%d", a, hist[a]);
+  printf("\n");
+  printf("wstest: OK\n");
+  exit(0);
+}
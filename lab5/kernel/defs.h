@@ -63,8 +63,14 @@ void            ramdiskrw(struct buf*);
 void*           kalloc(void);
 void            kfree(void *);
 void            kinit(void);
+void*           kalloc_zeroed(void);
+void            kzeroidle(void);
 void            incr(void *);
-void            desc(void *);
+int             pagerefs(void *);
+int             decr(void *);
+void            kfreepage(void *);
+void            mapincr(void *);
+void            mapdesc(void *);
 
 // log.c
 void            initlog(int, struct superblock*);
@@ -163,6 +169,8 @@ int             mappages(pagetable_t, uint64, uint64, uint64, int);
 pagetable_t     uvmcreate(void);
 void            uvminit(pagetable_t, uchar *, uint);
 uint64          uvmalloc(pagetable_t, uint64, uint64);
+uint64          uvmzero(pagetable_t, uint64, uint64);
+int             uvmresident(pagetable_t, uint64);
 uint64          uvmdealloc(pagetable_t, uint64, uint64);
 int             uvmcopy(pagetable_t, pagetable_t, uint64);
 void            uvmfree(pagetable_t, uint64);
@@ -49,7 +49,11 @@ exec(char *path, char **argv)
     if(ph.vaddr + ph.memsz < ph.vaddr)
       goto bad;
     uint64 sz1;
-    if((sz1 = uvmalloc(pagetable, sz, ph.vaddr + ph.memsz)) == 0)
+    // 只有装文件内容的页需要私有页，后面的BSS先映射到零页
+    if((sz1 = uvmalloc(pagetable, sz, ph.vaddr + ph.filesz)) == 0)
+      goto bad;
+    sz = sz1;
+    if((sz1 = uvmzero(pagetable, sz, ph.vaddr + ph.memsz)) == 0)
       goto bad;
     sz = sz1;
     if((ph.vaddr % PGSIZE) != 0)
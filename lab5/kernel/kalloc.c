@@ -1,6 +1,12 @@
 // Physical memory allocator, for user processes,
 // kernel stacks, page-table pages,
 // and pipe buffers. Allocates whole 4096-byte pages.
+//
+// Besides the ordinary free list, idle CPUs keep a pool of
+// pages that are already zeroed (see kzeroidle), so that
+// kalloc_zeroed() can skip the memset on the fault path.
+// Build with KALLOC_JUNK=1 to fill pages with junk on
+// kalloc/kfree to catch dangling references.
 
 #include "types.h"
 #include "param.h"
@@ -18,55 +24,75 @@ struct run {
   struct run *next;
 };
 
+#define NZEROPAGE 1024  // 预先清零的页数上限
+
 struct {
   struct spinlock lock;
   struct run *freelist;
-  int PG_total;
+  struct run *zerolist;  // 已清零的空闲页
+  int nzero;             // zerolist中的页数
+  int nzeroing;          // 正在被空闲CPU清零、暂时不在任何链表中的页数
 } kmem;
 
-int PG_cnt[PHYSTOP/PGSIZE];//采用引用计数对每一个PG的引用数量计数
-//这里的PHYSTOP/PGSIZE肯定是大于kmem.PG_total的，
-//因为并不是所有内存都被划分为了页表（猜测）
-int
-page_index(uint64 pa)
+// 每个物理页一项元数据，以(pa-KERNBASE)/PGSIZE为下标，
+// 计数都用原子操作更新，多个CPU同时fork/exit时不会丢失。
+struct page {
+  int refcnt;    // 引用计数，COW共享时大于1
+  int mapcount;  // 映射到用户页表中的次数
+  int flags;
+};
+
+#define PG_FREE 0x1  // 在freelist或zerolist中
+
+struct page pages[(PHYSTOP-KERNBASE)/PGSIZE];
+
+static struct page *
+pa2page(void *pa)
 {
-  pa = PGROUNDDOWN(pa);
-  int ans = (pa - (uint64)end)/PGSIZE;
-  if(ans < 0 || ans >= kmem.PG_total){
-    panic("page_index() fail");
-  }
-  return ans;
+  return &pages[((uint64)pa - KERNBASE) / PGSIZE];
 }
 
-void 
+// 增加一个引用（fork共享页时）
+void
 incr(void *pa)
 {
-  int index = page_index((uint64)pa);
-  PG_cnt[index]++;
+  __sync_fetch_and_add(&pa2page(pa)->refcnt, 1);
+}
+
+// 去掉一个引用但不释放，返回剩下的引用数。
+// 返回0时由调用者处理完页的内容后调用kfreepage()。
+int
+decr(void *pa)
+{
+  int ref = __sync_sub_and_fetch(&pa2page(pa)->refcnt, 1);
+  if(ref < 0)
+    panic("decr");
+  return ref;
 }
 
-void 
-desc(void *pa)
+int
+pagerefs(void *pa)
 {
-  int index = page_index((uint64)pa);
-  PG_cnt[index]--;
+  return __atomic_load_n(&pa2page(pa)->refcnt, __ATOMIC_SEQ_CST);
 }
 
+// 页被映射进/移出用户页表时调用
 void
-count_PG(void *pa_start, void *pa_end)
+mapincr(void *pa)
 {
-  char *p;
-  p = (char*)PGROUNDUP((uint64)pa_start);
-  for(; p + PGSIZE <= (char*)pa_end; p += PGSIZE){
-    kmem.PG_total++;
-  }
+  __sync_fetch_and_add(&pa2page(pa)->mapcount, 1);
+}
+
+void
+mapdesc(void *pa)
+{
+  __sync_fetch_and_sub(&pa2page(pa)->mapcount, 1);
 }
 
 void
 kinit()
 {
   initlock(&kmem.lock, "kmem");
-  count_PG(end, (void*)PHYSTOP);
   freerange(end, (void*)PHYSTOP);
 }
 
@@ -75,8 +101,10 @@ freerange(void *pa_start, void *pa_end)
 {
   char *p;
   p = (char*)PGROUNDUP((uint64)pa_start);
-  for(; p + PGSIZE <= (char*)pa_end; p += PGSIZE)
+  for(; p + PGSIZE <= (char*)pa_end; p += PGSIZE){
+    pa2page(p)->refcnt = 1;
     kfree(p);
+  }
 }
 
 // Free the page of physical memory pointed at by v,
@@ -86,31 +114,81 @@ freerange(void *pa_start, void *pa_end)
 void
 kfree(void *pa)
 {
-  int index = page_index((uint64)pa);
-  if(PG_cnt[index] > 1){//只有当他的引用计数为0的时候才释放内存
-    desc(pa);//如果引用计数大于1说明有至少两个进程对该页表引用了
-    //那么只要将其减一就表示去除一个引用
+  if(((uint64)pa % PGSIZE) != 0 || (char*)pa < end || (uint64)pa >= PHYSTOP)
+    panic("kfree");
+
+  //只有最后一个引用去掉时才真正释放，否则只是减一
+  int ref = __sync_sub_and_fetch(&pa2page(pa)->refcnt, 1);
+  if(ref > 0)
     return;
-  }
-  if(PG_cnt[index] == 1){
-    desc(pa);
-  }
+  if(ref < 0)
+    panic("kfree: double free");
+  kfreepage(pa);
+}
+
+// 把引用数已经降到0的页放回空闲链表
+void
+kfreepage(void *pa)
+{
   struct run *r;
+  struct page *pg;
 
-  if(((uint64)pa % PGSIZE) != 0 || (char*)pa < end || (uint64)pa >= PHYSTOP)
-    panic("kfree");
+  pg = pa2page(pa);
+  if(pg->refcnt != 0 || (pg->flags & PG_FREE))
+    panic("kfree: double free");
+  if(pg->mapcount != 0)
+    panic("kfree: page still mapped");
 
+#ifdef KALLOC_JUNK
   // Fill with junk to catch dangling refs.
   memset(pa, 1, PGSIZE);
+#endif
 
   r = (struct run*)pa;
 
   acquire(&kmem.lock);
+  pg->flags |= PG_FREE;
   r->next = kmem.freelist;
   kmem.freelist = r;
   release(&kmem.lock);
 }
 
+// 取一个空闲页，wantzero为真时优先从zerolist取，否则优先取未清零的页。
+// *zeroed返回该页是否已清零。两条链表都空但还有页正在清零时，
+// 等它回到zerolist，避免把暂时不在链表中的页当成内存耗尽。
+static struct run *
+kget(int wantzero, int *zeroed)
+{
+  struct run *r;
+
+  for(;;){
+    acquire(&kmem.lock);
+    if(kmem.zerolist && (wantzero || kmem.freelist == 0)){
+      r = kmem.zerolist;
+      kmem.zerolist = r->next;
+      r->next = 0;  // 链表指针占着清零页的前8字节，取出时清掉
+      kmem.nzero--;
+      *zeroed = 1;
+      break;
+    }
+    if(kmem.freelist){
+      r = kmem.freelist;
+      kmem.freelist = r->next;
+      *zeroed = 0;
+      break;
+    }
+    if(kmem.nzeroing == 0){
+      r = 0;
+      break;
+    }
+    release(&kmem.lock);
+  }
+  if(r)
+    pa2page(r)->flags &= ~PG_FREE;
+  release(&kmem.lock);
+  return r;
+}
+
 // Allocate one 4096-byte page of physical memory.
 // Returns a pointer that the kernel can use.
 // Returns 0 if the memory cannot be allocated.
@@ -118,16 +196,58 @@ void *
 kalloc(void)
 {
   struct run *r;
+  int zeroed;
 
-  acquire(&kmem.lock);
-  r = kmem.freelist;
-  if(r)
-    kmem.freelist = r->next;
-  release(&kmem.lock);
-
+  r = kget(0, &zeroed);
   if(r){
+#ifdef KALLOC_JUNK
     memset((char*)r, 5, PGSIZE); // fill with junk
+#endif
     incr(r);//申请内存时引用计数加一
   }
   return (void*)r;
 }
+
+// Allocate one zero-filled page, normally taken from the
+// pool that idle CPUs have already cleared.
+void *
+kalloc_zeroed(void)
+{
+  struct run *r;
+  int zeroed;
+
+  r = kget(1, &zeroed);
+  if(r){
+    if(!zeroed)
+      memset((char*)r, 0, PGSIZE);
+    incr(r);
+  }
+  return (void*)r;
+}
+
+// Called by the scheduler when a CPU has nothing to run:
+// move one page from the free list to the zeroed pool.
+void
+kzeroidle(void)
+{
+  struct run *r;
+
+  acquire(&kmem.lock);
+  r = kmem.freelist;
+  if(r == 0 || kmem.nzero >= NZEROPAGE){
+    release(&kmem.lock);
+    return;
+  }
+  kmem.freelist = r->next;
+  kmem.nzeroing++;
+  release(&kmem.lock);
+
+  memset((char*)r, 0, PGSIZE);  // 清零时不持有锁
+
+  acquire(&kmem.lock);
+  r->next = kmem.zerolist;
+  kmem.zerolist = r;
+  kmem.nzero++;
+  kmem.nzeroing--;
+  release(&kmem.lock);
+}
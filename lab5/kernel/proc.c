@@ -257,7 +257,11 @@ growproc(int n)
 
   sz = p->sz;
   if(n > 0){
-    if((sz = uvmalloc(p->pagetable, sz, sz + n)) == 0) {
+    // 新页都映射到零页，不占物理内存，所以要另外限制进程
+    // 不能大于物理内存，否则只读的进程可以无限sbrk
+    if((uint64)sz + n > PHYSTOP - KERNBASE)
+      return -1;
+    if((sz = uvmzero(p->pagetable, sz, sz + n)) == 0) {
       return -1;
     }
   } else if(n < 0){
@@ -445,6 +449,7 @@ scheduler(void)
     // Avoid deadlock by ensuring that devices can interrupt.
     intr_on();
 
+    int found = 0;
     for(p = proc; p < &proc[NPROC]; p++) {
       acquire(&p->lock);
       if(p->state == RUNNABLE) {
@@ -458,9 +463,12 @@ scheduler(void)
         // Process is done running for now.
         // It should have changed its p->state before coming back.
         c->proc = 0;
+        found = 1;
       }
       release(&p->lock);
     }
+    if(found == 0)
+      kzeroidle();  // 没有可运行的进程，趁空闲预先清零空闲页
   }
 }
 
@@ -95,3 +95,13 @@ sys_uptime(void)
   release(&tickslock);
   return xticks;
 }
+
+// 返回本进程有私有物理页的用户页数，
+// 与sbrk(0)/PGSIZE的虚拟页数对比可以看出零页省下的内存
+uint64
+sys_rss(void)
+{
+  struct proc *p = myproc();
+
+  return uvmresident(p->pagetable, p->sz);
+}
@@ -15,14 +15,23 @@ extern char etext[];  // kernel.ld sets this to end of kernel code.
 
 extern char trampoline[]; // trampoline.S
 
+static pde_t *walkpde(pagetable_t, uint64, int);
+static int unsharept(pde_t *);
+
+static char *zeropage;  // 所有进程共享的只读零页
+
+// fork时父子进程共享末级页表页（引用计数记在页表页的struct page里），
+// 共享的末级页表中没有可写的叶子PTE，谁要改其中的PTE就先复制一份。
+// 数据页的引用计数记的是引用它的末级页表数，而不是进程数。
+#define PTSPAN ((uint64)PGSIZE * 512)  // 一张末级页表映射的字节数
+
 // Make a direct-map page table for the kernel.
 pagetable_t
 kvmmake(void)
 {
   pagetable_t kpgtbl;
 
-  kpgtbl = (pagetable_t) kalloc();
-  memset(kpgtbl, 0, PGSIZE);
+  kpgtbl = (pagetable_t) kalloc_zeroed();
 
   // uart registers
   kvmmap(kpgtbl, UART0, UART0, PGSIZE, PTE_R | PTE_W);
@@ -54,6 +63,10 @@ void
 kvminit(void)
 {
   kernel_pagetable = kvmmake();
+  // 内核持有零页的一个引用且永不释放，所以它的引用计数不会降到1，
+  // cow_alloc总会给写者分配私有页
+  if((zeropage = kalloc_zeroed()) == 0)
+    panic("kvminit: zeropage");
 }
 
 // Switch h/w page table register to the kernel's page table,
@@ -77,26 +90,87 @@ kvminithart()
 //   21..29 -- 9 bits of level-1 index.
 //   12..20 -- 9 bits of level-0 index.
 //    0..11 -- 12 bits of byte offset within the page.
+//
+// alloc!=0 also means the caller is about to change the PTE,
+// so a last-level page shared with another process is copied
+// first (see unsharept).
 pte_t *
 walk(pagetable_t pagetable, uint64 va, int alloc)
 {
+  pde_t *pde;
+
   if(va >= MAXVA)
     panic("walk");
 
-  for(int level = 2; level > 0; level--) {
-    pte_t *pte = &pagetable[PX(level, va)];
-    if(*pte & PTE_V) {
-      pagetable = (pagetable_t)PTE2PA(*pte);
-    } else {
-      if(!alloc || (pagetable = (pde_t*)kalloc()) == 0)
-        return 0;
-      memset(pagetable, 0, PGSIZE);
-      *pte = PA2PTE(pagetable) | PTE_V;
-    }
+  if((pde = walkpde(pagetable, va, alloc)) == 0)
+    return 0;
+  if(*pde & PTE_V) {
+    if(alloc && unsharept(pde) != 0)
+      return 0;
+    pagetable = (pagetable_t)PTE2PA(*pde);
+  } else {
+    if(!alloc || (pagetable = (pde_t*)kalloc_zeroed()) == 0)
+      return 0;
+    *pde = PA2PTE(pagetable) | PTE_V;
   }
   return &pagetable[PX(0, va)];
 }
 
+// 返回指向va所在末级页表的level-1 PTE，alloc!=0时按需分配level-1页表
+static pde_t *
+walkpde(pagetable_t pagetable, uint64 va, int alloc)
+{
+  pte_t *pte = &pagetable[PX(2, va)];
+
+  if(*pte & PTE_V) {
+    pagetable = (pagetable_t)PTE2PA(*pte);
+  } else {
+    if(!alloc || (pagetable = (pde_t*)kalloc_zeroed()) == 0)
+      return 0;
+    *pte = PA2PTE(pagetable) | PTE_V;
+  }
+  return &pagetable[PX(1, va)];
+}
+
+// 去掉对末级页表pt的一个引用，最后一个引用去掉时连同其中映射的页一起释放
+static void
+ptput(pagetable_t pt)
+{
+  if(decr(pt) > 0)
+    return;
+  for(int i = 0; i < 512; i++){
+    if(pt[i] & PTE_V){
+      mapdesc((void*)PTE2PA(pt[i]));
+      kfree((void*)PTE2PA(pt[i]));
+    }
+  }
+  kfreepage(pt);
+}
+
+// 如果pde指向的末级页表还与别的进程共享，就换成一份私有的复制，
+// 复制中映射的每一页多了一个引用。内存不够时返回-1。
+static int
+unsharept(pde_t *pde)
+{
+  pagetable_t pt, npt;
+
+  pt = (pagetable_t)PTE2PA(*pde);
+  if(pagerefs(pt) == 1)
+    return 0;
+  if((npt = (pagetable_t)kalloc()) == 0)
+    return -1;
+  memmove(npt, pt, PGSIZE);
+  for(int i = 0; i < 512; i++){
+    if(npt[i] & PTE_V){
+      incr((void*)PTE2PA(npt[i]));
+      mapincr((void*)PTE2PA(npt[i]));
+    }
+  }
+  *pde = PA2PTE(npt) | PTE_V;
+  ptput(pt);
+  return 0;
+}
+
 // Look up a virtual address, return the physical address,
 // or 0 if not mapped.
 // Can only be used to look up user pages.
@@ -159,27 +233,55 @@ mappages(pagetable_t pagetable, uint64 va, uint64 size, uint64 pa, int perm)
   return 0;
 }
 
+// 末级页表pt（映射从base开始的PTSPAN字节）中的有效映射是否都在[va, end)内
+static int
+ptcovered(pagetable_t pt, uint64 base, uint64 va, uint64 end)
+{
+  for(int i = 0; i < 512; i++){
+    uint64 a = base + i * PGSIZE;
+    if((pt[i] & PTE_V) && (a < va || a >= end))
+      return 0;
+  }
+  return 1;
+}
+
 // Remove npages of mappings starting from va. va must be
 // page-aligned. The mappings must exist.
 // Optionally free the physical memory.
 void
 uvmunmap(pagetable_t pagetable, uint64 va, uint64 npages, int do_free)
 {
-  uint64 a;
+  uint64 a, end, base;
   pte_t *pte;
+  pde_t *pde;
 
   if((va % PGSIZE) != 0)
     panic("uvmunmap: not aligned");
 
-  for(a = va; a < va + npages*PGSIZE; a += PGSIZE){
-    if((pte = walk(pagetable, a, 0)) == 0)
+  end = va + npages*PGSIZE;
+  for(a = va; a < end; a += PGSIZE){
+    if((pde = walkpde(pagetable, a, 0)) == 0 || (*pde & PTE_V) == 0)
       panic("uvmunmap: walk");
+    if(pagerefs((void*)PTE2PA(*pde)) > 1){
+      base = a - a % PTSPAN;
+      if(do_free && ptcovered((pagetable_t)PTE2PA(*pde), base, va, end)){
+        // 共享页表中的映射全部要解除（比如exit、exec），只去掉本进程的引用
+        ptput((pagetable_t)PTE2PA(*pde));
+        *pde = 0;
+        a = base + PTSPAN - PGSIZE;
+        continue;
+      }
+      if(unsharept(pde) != 0)
+        panic("uvmunmap: unshare");
+    }
+    pte = &((pagetable_t)PTE2PA(*pde))[PX(0, a)];
     if((*pte & PTE_V) == 0)
       panic("uvmunmap: not mapped");
     if(PTE_FLAGS(*pte) == PTE_V)
       panic("uvmunmap: not a leaf");
     if(do_free){
       uint64 pa = PTE2PA(*pte);
+      mapdesc((void*)pa);
       kfree((void*)pa);
     }
     *pte = 0;
@@ -192,10 +294,9 @@ pagetable_t
 uvmcreate()
 {
   pagetable_t pagetable;
-  pagetable = (pagetable_t) kalloc();
+  pagetable = (pagetable_t) kalloc_zeroed();
   if(pagetable == 0)
     return 0;
-  memset(pagetable, 0, PGSIZE);
   return pagetable;
 }
 
@@ -209,9 +310,9 @@ uvminit(pagetable_t pagetable, uchar *src, uint sz)
 
   if(sz >= PGSIZE)
     panic("inituvm: more than a page");
-  mem = kalloc();
-  memset(mem, 0, PGSIZE);
+  mem = kalloc_zeroed();
   mappages(pagetable, 0, PGSIZE, (uint64)mem, PTE_W|PTE_R|PTE_X|PTE_U);
+  mapincr(mem);
   memmove(mem, src, sz);
 }
 
@@ -228,17 +329,39 @@ uvmalloc(pagetable_t pagetable, uint64 oldsz, uint64 newsz)
 
   oldsz = PGROUNDUP(oldsz);
   for(a = oldsz; a < newsz; a += PGSIZE){
-    mem = kalloc();
+    mem = kalloc_zeroed();
     if(mem == 0){
       uvmdealloc(pagetable, a, oldsz);
       return 0;
     }
-    memset(mem, 0, PGSIZE);
     if(mappages(pagetable, a, PGSIZE, (uint64)mem, PTE_W|PTE_X|PTE_R|PTE_U) != 0){
       kfree(mem);
       uvmdealloc(pagetable, a, oldsz);
       return 0;
     }
+    mapincr(mem);
+  }
+  return newsz;
+}
+
+// 与uvmalloc相同，但所有新页都只读地映射到共享的零页并标记PTE_COW，
+// 第一次写时才由cow_alloc分配私有页。
+uint64
+uvmzero(pagetable_t pagetable, uint64 oldsz, uint64 newsz)
+{
+  uint64 a;
+
+  if(newsz < oldsz)
+    return oldsz;
+
+  oldsz = PGROUNDUP(oldsz);
+  for(a = oldsz; a < newsz; a += PGSIZE){
+    if(mappages(pagetable, a, PGSIZE, (uint64)zeropage, PTE_R|PTE_X|PTE_U|PTE_COW) != 0){
+      uvmdealloc(pagetable, a, oldsz);
+      return 0;
+    }
+    incr(zeropage);
+    mapincr(zeropage);
   }
   return newsz;
 }
@@ -293,38 +416,39 @@ uvmfree(pagetable_t pagetable, uint64 sz)
 
 // Given a parent process's page table, copy
 // its memory into a child's page table.
-// Copies both the page table and the
-// physical memory.
+// Shares the parent's last-level page-table pages with the
+// child instead of copying them; whoever first changes a PTE
+// in a shared page copies it (see unsharept).
 // returns 0 on success, -1 on failure.
 // frees any allocated pages on failure.
 int
 uvmcopy(pagetable_t old, pagetable_t new, uint64 sz)
 {
-  pte_t *pte;
-  uint64 pa, i;
-  uint flags;
-
-  for(i = 0; i < sz; i += PGSIZE){
-    if((pte = walk(old, i, 0)) == 0)
-      panic("uvmcopy: pte should exist");
-    if((*pte & PTE_V) == 0)
-      panic("uvmcopy: page not present");
-    pa = PTE2PA(*pte);
-    *pte = *pte & ~(PTE_W);
-    *pte = *pte | PTE_COW; //声明该页表项是一个cow页表项
-    flags = PTE_FLAGS(*pte);
-    //if((mem = kalloc()) == 0) 不应该分配新的页表
-      //goto err;
-    //memmove(mem, (char*)pa, PGSIZE);
-    if(mappages(new, i, PGSIZE, pa, flags) != 0){//直接将new的页表和pa创建映射关系
+  pde_t *pde, *npde;
+  pagetable_t pt;
+  uint64 va;
+
+  for(va = 0; va < sz; va += PTSPAN){
+    if((pde = walkpde(old, va, 0)) == 0 || (*pde & PTE_V) == 0)
+      continue;
+    if((npde = walkpde(new, va, 1)) == 0)
       goto err;
+    pt = (pagetable_t)PTE2PA(*pde);
+    if(pagerefs(pt) == 1){
+      // 第一次共享这张页表：把其中可写的页都改成只读的cow页。
+      // 已经共享的页表里不会有可写的页。
+      for(int i = 0; i < 512; i++){
+        if((pt[i] & PTE_V) && (pt[i] & PTE_W))
+          pt[i] = (pt[i] & ~PTE_W) | PTE_COW;
+      }
     }
-    incr((void *)pa);
+    incr(pt);
+    *npde = *pde;
   }
   return 0;
 
  err:
-  uvmunmap(new, 0, i / PGSIZE, 1);
+  uvmunmap(new, 0, va / PGSIZE, 1);
   return -1;
 }
 
@@ -335,7 +459,7 @@ uvmclear(pagetable_t pagetable, uint64 va)
 {
   pte_t *pte;
   
-  pte = walk(pagetable, va, 0);
+  pte = walk(pagetable, va, 1);
   if(pte == 0)
     panic("uvmclear");
   *pte &= ~PTE_U;
@@ -359,6 +483,9 @@ copyout(pagetable_t pagetable, uint64 dstva, char *src, uint64 len)
     pa0 = walkaddr(pagetable, va0);
     if(pa0 == 0)
       return -1;
+    //只读页（比如代码段）可能在共享的页表里，不能直接写
+    if((*walk(pagetable, va0, 0) & PTE_W) == 0)
+      return -1;
     n = PGSIZE - (dstva - va0);
     if(n > len)
       n = len;
@@ -463,22 +590,50 @@ int
 cow_alloc(pagetable_t pagetable, uint64 va)
 {
   va = PGROUNDDOWN(va);
-  pte_t *pte = walk(pagetable, va, 0);
+  pte_t *pte = walk(pagetable, va, 1);//末级页表还与别的进程共享时先复制
+  if(pte == 0)
+    return -1;
   uint flags;
   flags = PTE_FLAGS(*pte);
   flags = flags & ~(PTE_COW);//cow上的标志位清除
   flags = flags | PTE_W;//给一个写权限
   uint64 pa = PTE2PA(*pte);
-  char *mem = kalloc();
-  if(mem == 0){
-    return -1;//mem内存申请失败
+  if(pagerefs((void *)pa) == 1){
+    //其他进程都已经复制走或退出了，只剩自己引用，不用复制，直接恢复写权限
+    *pte = PA2PTE(pa) | flags;
+    return 0;
   }
-  memmove(mem, (char *)pa, PGSIZE);//解除映射前先把mem保存下来
-  uvmunmap(pagetable, va, 1, 1); //解除原有的映射关系，第三个参数1表示解除一个PAGESIZE大小的关系
-
-  if(mappages(pagetable, va, PGSIZE, (uint64)mem, flags) < 0){
-    kfree(mem);
-    return -1;
+  char *mem;
+  if((char *)pa == zeropage){
+    //零页不用复制，直接拿一个清零的页
+    if((mem = kalloc_zeroed()) == 0)
+      return -1;
+  } else {
+    if((mem = kalloc()) == 0)
+      return -1;//mem内存申请失败
+    memmove(mem, (char *)pa, PGSIZE);
   }
+  //直接改写页表项指向新页，不必先uvmunmap再mappages重新walk
+  *pte = PA2PTE(mem) | flags;
+  mapincr(mem);
+  mapdesc((void *)pa);
+  kfree((void *)pa);//去掉对原页的引用
   return 0;
-}
\ No newline at end of file
+}
+
+// 统计用户地址空间[0, sz)中有多少页有自己的物理页（不是零页），
+// 与COW共享的页一样，每个映射它的进程都算一次。
+int
+uvmresident(pagetable_t pagetable, uint64 sz)
+{
+  pte_t *pte;
+  int n = 0;
+
+  for(uint64 a = 0; a < sz; a += PGSIZE){
+    if((pte = walk(pagetable, a, 0)) == 0 || (*pte & PTE_V) == 0)
+      continue;
+    if((char *)PTE2PA(*pte) != zeropage)
+      n++;
+  }
+  return n;
+}
@@ -177,6 +177,73 @@ filetest()
   printf("ok\n");
 }
 
+// sbrk'd memory that is only read should share the zero
+// page; each written page should get its own.
+void
+zerotest()
+{
+  enum { N = 1024 };
+  int r0, r;
+
+  printf("zero: ");
+
+  r0 = rss();
+  char *p = sbrk(N * 4096);
+  if(p == (char*)0xffffffffffffffffL){
+    printf("sbrk(%d) failed\n", N * 4096);
+    exit(-1);
+  }
+
+  for(int i = 0; i < N; i++){
+    if(p[i * 4096] != 0){
+      printf("error: sbrk memory not zero\n");
+      exit(-1);
+    }
+  }
+  if((r = rss()) != r0){
+    printf("error: %d resident pages after reading, expected %d\n", r, r0);
+    exit(-1);
+  }
+
+  for(int i = 0; i < N; i += 16)
+    p[i * 4096] = 1;
+  if((r = rss()) != r0 + N / 16){
+    printf("error: %d resident pages after writing, expected %d\n", r, r0 + N / 16);
+    exit(-1);
+  }
+
+  int pid = fork();
+  if(pid < 0){
+    printf("fork() failed\n");
+    exit(-1);
+  }
+  if(pid == 0){
+    for(int i = 0; i < N; i++){
+      if(p[i * 4096] != (i % 16 == 0)){
+        printf("error: child read the wrong value\n");
+        exit(1);
+      }
+    }
+    p[4096] = 2;
+    exit(0);
+  }
+  int xstatus;
+  wait(&xstatus);
+  if(xstatus != 0)
+    exit(1);
+  if(p[4096] != 0){
+    printf("error: child wrote the zero page\n");
+    exit(1);
+  }
+
+  if(sbrk(-N * 4096) == (char*)0xffffffffffffffffL){
+    printf("sbrk(-%d) failed\n", N * 4096);
+    exit(-1);
+  }
+
+  printf("ok\n");
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -191,6 +258,8 @@ main(int argc, char *argv[])
 
   filetest();
 
+  zerotest();
+
   printf("ALL COW TESTS PASSED\n");
 
   exit(0);
@@ -6,6 +6,7 @@
 #include "user/user.h"
 
 #define N  1000
+#define NTIME 20   // forks timed per size
 
 void
 print(const char *s)
@@ -13,6 +14,20 @@ print(const char *s)
   write(1, s, strlen(s));
 }
 
+void
+printnum(int n)
+{
+  char buf[16];
+  int i = sizeof(buf);
+
+  buf[--i] = 0;
+  do {
+    buf[--i] = '0' + n % 10;
+    n /= 10;
+  } while(n > 0);
+  print(buf + i);
+}
+
 void
 forktest(void)
 {
@@ -48,9 +63,50 @@ forktest(void)
   print("fork test OK\n");
 }
 
+// time fork() of a process with mb megabytes of written heap.
+void
+forktime(int mb)
+{
+  int i, pid, t0, t1;
+  int sz = mb * 1024 * 1024;
+  char *p;
+
+  p = sbrk(sz);
+  if(p == (char*)-1){
+    print("sbrk failed\n");
+    exit(1);
+  }
+  for(i = 0; i < sz; i += 4096)
+    p[i] = 1;
+
+  t0 = uptime();
+  for(i = 0; i < NTIME; i++){
+    pid = fork();
+    if(pid < 0){
+      print("fork failed\n");
+      exit(1);
+    }
+    if(pid == 0)
+      exit(0);
+    wait(0);
+  }
+  t1 = uptime();
+
+  printnum(NTIME);
+  print(" forks of ");
+  printnum(mb);
+  print(" MB: ");
+  printnum(t1 - t0);
+  print(" ticks\n");
+  sbrk(-sz);
+}
+
 int
 main(void)
 {
   forktest();
+  forktime(1);
+  forktime(16);
+  forktime(64);
   exit(0);
 }
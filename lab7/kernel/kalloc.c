@@ -7,6 +7,7 @@
 #include "memlayout.h"
 #include "spinlock.h"
 #include "riscv.h"
+#include "shrinker.h"
 #include "defs.h"
 
 void freerange(void *pa_start, void *pa_end);
@@ -23,6 +24,10 @@ struct {
   struct run *freelist;
 } kmem;
 
+#define NSHRINKER 8
+static struct shrinker *shrinkers[NSHRINKER];
+static int nshrinker;
+
 void
 kinit()
 {
@@ -62,6 +67,39 @@ kfree(void *pa)
   release(&kmem.lock);
 }
 
+// Called during boot, before other CPUs start.
+void
+register_shrinker(struct shrinker *s)
+{
+  if(nshrinker == NSHRINKER)
+    panic("register_shrinker");
+  shrinkers[nshrinker++] = s;
+}
+
+// Run every shrinker once, in registration order.
+// Returns the total they released.
+static int
+shrink(void)
+{
+  int n, total = 0;
+
+  for(int i = 0; i < nshrinker; i++){
+    n = shrinkers[i]->scan();
+    __sync_fetch_and_add(&shrinkers[i]->ncall, 1);
+    __sync_fetch_and_add(&shrinkers[i]->nreclaimed, n);
+    total += n;
+  }
+  return total;
+}
+
+void
+shrinkdump(void)
+{
+  for(int i = 0; i < nshrinker; i++)
+    printf("shrinker %s: %d calls, %d reclaimed\n",
+           shrinkers[i]->name, shrinkers[i]->ncall, shrinkers[i]->nreclaimed);
+}
+
 // Allocate one 4096-byte page of physical memory.
 // Returns a pointer that the kernel can use.
 // Returns 0 if the memory cannot be allocated.
@@ -70,12 +108,18 @@ kalloc(void)
 {
   struct run *r;
 
+again:
   acquire(&kmem.lock);
   r = kmem.freelist;
   if(r)
     kmem.freelist = r->next;
   release(&kmem.lock);
 
+  // out of pages: ask the other subsystems to give some back,
+  // and keep trying as long as they make progress.
+  if(r == 0 && shrink() > 0)
+    goto again;
+
   if(r)
     memset((char*)r, 5, PGSIZE); // fill with junk
   return (void*)r;
@@ -20,6 +20,7 @@ main()
     printf("xv6 kernel is booting\n");
     printf("\n");
     kinit();         // physical page allocator
+    slabinit();      // kernel object caches
     kvminit();       // create kernel page table
     kvminithart();   // turn on paging
     procinit();      // process table
@@ -30,8 +31,10 @@ main()
     binit();         // buffer cache
     iinit();         // inode table
     fileinit();      // file table
+    pipeinit();      // pipe object cache
     virtio_disk_init(); // emulated hard disk
 #ifdef LAB_NET
+    mbufinit();
     pci_init();
     sockinit();
 #endif    
@@ -9,6 +9,7 @@
 #include "spinlock.h"
 #include "proc.h"
 #include "net.h"
+#include "slab.h"
 #include "defs.h"
 
 static uint32 local_ip = MAKE_IP_ADDR(10, 0, 2, 15); // qemu's idea of the guest IP
@@ -61,6 +62,18 @@ mbuftrim(struct mbuf *m, unsigned int len)
   return m->head + m->len;
 }
 
+// The mbuf header and its backing store come from separate
+// caches, so two 2 KB buffers share one page.
+static struct kmem_cache mbufcache;
+static struct kmem_cache mbufdatacache;
+
+void
+mbufinit(void)
+{
+  kmem_cache_init(&mbufcache, "mbuf", sizeof(struct mbuf));
+  kmem_cache_init(&mbufdatacache, "mbufdata", MBUF_SIZE);
+}
+
 // Allocates a packet buffer.
 struct mbuf *
 mbufalloc(unsigned int headroom)
@@ -69,13 +82,18 @@ mbufalloc(unsigned int headroom)
  
   if (headroom > MBUF_SIZE)
     return 0;
-  m = kalloc();
+  m = kmem_cache_alloc(&mbufcache);
   if (m == 0)
     return 0;
+  m->buf = kmem_cache_alloc(&mbufdatacache);
+  if (m->buf == 0) {
+    kmem_cache_free(&mbufcache, m);
+    return 0;
+  }
   m->next = 0;
   m->head = (char *)m->buf + headroom;
   m->len = 0;
-  memset(m->buf, 0, sizeof(m->buf));
+  memset(m->buf, 0, MBUF_SIZE);
   return m;
 }
 
@@ -83,7 +101,8 @@ mbufalloc(unsigned int headroom)
 void
 mbuffree(struct mbuf *m)
 {
-  kfree(m);
+  kmem_cache_free(&mbufdatacache, m->buf);
+  kmem_cache_free(&mbufcache, m);
 }
 
 // Pushes an mbuf to the end of the queue.
@@ -9,7 +9,7 @@ struct mbuf {
   struct mbuf  *next; // the next mbuf in the chain
   char         *head; // the current start position of the buffer
   unsigned int len;   // the length of the buffer
-  char         buf[MBUF_SIZE]; // the backing store
+  char         *buf;  // the backing store, MBUF_SIZE bytes
 };
 
 char *mbufpull(struct mbuf *m, unsigned int len);
@@ -653,4 +653,5 @@ procdump(void)
     printf("%d %s %s", p->pid, state, p->name);
     printf("\n");
   }
+  shrinkdump();
 }
@@ -0,0 +1,8 @@
+// A subsystem that holds memory it could give back registers a
+// shrinker; kalloc() runs them all when its free list is empty.
+struct shrinker {
+  char *name;
+  int (*scan)(void);  // release what can be released, return how much (0 if nothing)
+  int ncall;          // times scan() was called
+  int nreclaimed;     // sum of scan()'s return values
+};
@@ -0,0 +1,275 @@
+// Slab allocator for fixed-size kernel objects.
+//
+// Each kmem_cache carves whole pages from kalloc() into
+// objects of one size. The page's bookkeeping lives in
+// slabs[], indexed by physical page number, so the page
+// itself holds nothing but objects. Each CPU keeps a small
+// array of free objects in front of the slabs; a page goes
+// back to kalloc() as soon as all of its objects are free.
+//
+// Interface:
+// * kmem_cache_init() once per object type.
+// * kmem_cache_alloc()/kmem_cache_free() for objects.
+// * slabinit() registers a shrinker that gives cached
+//   objects back so that empty pages can be freed when
+//   kalloc() runs dry.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "spinlock.h"
+#include "riscv.h"
+#include "slab.h"
+#include "shrinker.h"
+#include "defs.h"
+
+#define NCACHE 8
+#define NPAGE ((PHYSTOP - KERNBASE) / PGSIZE)
+#define PA2IDX(pa) ((PGROUNDDOWN((uint64)(pa)) - KERNBASE) / PGSIZE)
+
+struct obj {
+  struct obj *next;
+};
+
+struct slab {
+  struct kmem_cache *cache;
+  struct slab *next;          // on cache->partial
+  struct slab *prev;
+  struct obj *freelist;       // free objects in this page
+  int inuse;                  // objects handed out of this page
+};
+
+static struct slab slabs[NPAGE];
+
+static struct kmem_cache *caches[NCACHE];  // for kmem_reap
+
+void
+kmem_cache_init(struct kmem_cache *c, char *name, uint size)
+{
+  if(size > PGSIZE)
+    panic("kmem_cache_init: size");
+  c->name = name;
+  c->size = (size + 7) & ~7;
+  c->perslab = PGSIZE / c->size;
+  c->partial = 0;
+  c->nslab = 0;
+  initlock(&c->lock, name);
+  for(int i = 0; i < NCPU; i++){
+    initlock(&c->cpu[i].lock, name);
+    c->cpu[i].n = 0;
+  }
+
+  // caches are only created while booting on one CPU.
+  for(int i = 0; i < NCACHE; i++){
+    if(caches[i] == 0){
+      caches[i] = c;
+      return;
+    }
+  }
+  panic("kmem_cache_init: too many caches");
+}
+
+static void
+partial_add(struct kmem_cache *c, struct slab *s)
+{
+  s->prev = 0;
+  s->next = c->partial;
+  if(s->next)
+    s->next->prev = s;
+  c->partial = s;
+}
+
+static void
+partial_remove(struct kmem_cache *c, struct slab *s)
+{
+  if(s->prev)
+    s->prev->next = s->next;
+  else
+    c->partial = s->next;
+  if(s->next)
+    s->next->prev = s->prev;
+  s->next = s->prev = 0;
+}
+
+// Give an empty slab's page back to kalloc().
+// Caller holds c->lock.
+static void
+slab_release(struct kmem_cache *c, struct slab *s)
+{
+  partial_remove(c, s);
+  s->cache = 0;
+  s->freelist = 0;
+  c->nslab--;
+  kfree((void*)(KERNBASE + (s - slabs) * PGSIZE));
+}
+
+// Return one object to its slab, freeing the page once the
+// slab is empty. Returns 1 if a page was freed.
+// Caller holds c->lock.
+static int
+slab_put(struct kmem_cache *c, void *p)
+{
+  struct slab *s = &slabs[PA2IDX(p)];
+  struct obj *o = (struct obj*)p;
+
+  if(s->cache != c)
+    panic("kmem_cache_free: wrong cache");
+  if(s->freelist == 0)
+    partial_add(c, s);   // was full
+  o->next = s->freelist;
+  s->freelist = o;
+  if(--s->inuse == 0){
+    slab_release(c, s);
+    return 1;
+  }
+  return 0;
+}
+
+// Move up to SLAB_BATCH objects from the partial slabs into
+// this CPU's array. Caller holds cc->lock.
+static void
+cpu_refill(struct kmem_cache *c, struct kmem_cache_cpu *cc)
+{
+  struct slab *s;
+  struct obj *o;
+
+  acquire(&c->lock);
+  while(cc->n < SLAB_BATCH && (s = c->partial) != 0){
+    o = s->freelist;
+    s->freelist = o->next;
+    s->inuse++;
+    cc->obj[cc->n++] = o;
+    if(s->freelist == 0)
+      partial_remove(c, s);
+  }
+  release(&c->lock);
+}
+
+// Give the oldest n objects of this CPU back to their slabs.
+// Returns the number of pages freed. Caller holds cc->lock.
+static int
+cpu_flush(struct kmem_cache *c, struct kmem_cache_cpu *cc, int n)
+{
+  int freed = 0;
+
+  acquire(&c->lock);
+  for(int i = 0; i < n; i++)
+    freed += slab_put(c, cc->obj[i]);
+  release(&c->lock);
+  for(int i = n; i < cc->n; i++)
+    cc->obj[i-n] = cc->obj[i];
+  cc->n -= n;
+  return freed;
+}
+
+// Add a fresh page to the cache. Called without any of the
+// cache's locks held, since kalloc() may call kmem_reap().
+static int
+cache_grow(struct kmem_cache *c)
+{
+  char *pa;
+  struct slab *s;
+  struct obj *o;
+
+  if((pa = kalloc()) == 0)
+    return -1;
+  s = &slabs[PA2IDX(pa)];
+  s->cache = c;
+  s->inuse = 0;
+  s->freelist = 0;
+  for(int i = c->perslab - 1; i >= 0; i--){
+    o = (struct obj*)(pa + i * c->size);
+    o->next = s->freelist;
+    s->freelist = o;
+  }
+  acquire(&c->lock);
+  partial_add(c, s);
+  c->nslab++;
+  release(&c->lock);
+  return 0;
+}
+
+// Allocate one object. Returns 0 if out of memory.
+// The object's contents are undefined.
+void *
+kmem_cache_alloc(struct kmem_cache *c)
+{
+  struct kmem_cache_cpu *cc;
+  void *p;
+
+  for(;;){
+    push_off();
+    cc = &c->cpu[cpuid()];
+    acquire(&cc->lock);
+    if(cc->n == 0)
+      cpu_refill(c, cc);
+    if(cc->n > 0){
+      p = cc->obj[--cc->n];
+      release(&cc->lock);
+      pop_off();
+      return p;
+    }
+    release(&cc->lock);
+    pop_off();
+
+    if(cache_grow(c) < 0)
+      return 0;
+  }
+}
+
+void
+kmem_cache_free(struct kmem_cache *c, void *p)
+{
+  struct kmem_cache_cpu *cc;
+
+  push_off();
+  cc = &c->cpu[cpuid()];
+  acquire(&cc->lock);
+  if(cc->n == SLAB_CPU_MAX)
+    cpu_flush(c, cc, SLAB_CPU_MAX / 2);
+  cc->obj[cc->n++] = p;
+  release(&cc->lock);
+  pop_off();
+}
+
+// Return every CPU's cached objects to the slabs and free
+// the pages of empty slabs. Returns the number of pages freed.
+static int
+kmem_reap(void)
+{
+  struct kmem_cache *c;
+  struct slab *s, *next;
+  int freed = 0;
+
+  for(int i = 0; i < NCACHE; i++){
+    if((c = caches[i]) == 0)
+      break;
+    for(int j = 0; j < NCPU; j++){
+      acquire(&c->cpu[j].lock);
+      freed += cpu_flush(c, &c->cpu[j], c->cpu[j].n);
+      release(&c->cpu[j].lock);
+    }
+    // pages added by cache_grow() that were never used
+    acquire(&c->lock);
+    for(s = c->partial; s; s = next){
+      next = s->next;
+      if(s->inuse == 0){
+        slab_release(c, s);
+        freed++;
+      }
+    }
+    release(&c->lock);
+  }
+  return freed;
+}
+
+static struct shrinker slabshrinker = {
+  .name = "slab",
+  .scan = kmem_reap,
+};
+
+void
+slabinit(void)
+{
+  register_shrinker(&slabshrinker);
+}
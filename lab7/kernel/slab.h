@@ -0,0 +1,19 @@
+// Object caches for kernel objects smaller than a page.
+#define SLAB_CPU_MAX 16   // max free objects cached per CPU
+#define SLAB_BATCH    8   // objects moved between a CPU and its slabs at once
+
+struct kmem_cache_cpu {
+  struct spinlock lock;
+  int n;                      // number of objects in obj[]
+  void *obj[SLAB_CPU_MAX];    // free objects owned by this CPU
+};
+
+struct kmem_cache {
+  char *name;
+  uint size;                  // object size, rounded up to 8 bytes
+  uint perslab;               // objects per page
+  struct spinlock lock;       // protects partial and the slabs on it
+  struct slab *partial;       // slabs with at least one free object
+  int nslab;                  // pages currently owned by this cache
+  struct kmem_cache_cpu cpu[NCPU];
+};
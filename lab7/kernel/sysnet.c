@@ -13,6 +13,8 @@
 #include "sleeplock.h"
 #include "file.h"
 #include "net.h"
+#include "slab.h"
+#include "shrinker.h"
 
 struct sock {
   struct sock *next; // the next socket in the list
@@ -25,11 +27,20 @@ struct sock {
 
 static struct spinlock lock;
 static struct sock *sockets;
+static struct kmem_cache sockcache;
+
+static int sockshrink(void);
+static struct shrinker sockshrinker = {
+  .name = "sockrxq",
+  .scan = sockshrink,
+};
 
 void
 sockinit(void)
 {
   initlock(&lock, "socktbl");
+  kmem_cache_init(&sockcache, "sock", sizeof(struct sock));
+  register_shrinker(&sockshrinker);
 }
 
 int
@@ -41,7 +52,7 @@ sockalloc(struct file **f, uint32 raddr, uint16 lport, uint16 rport)
   *f = 0;
   if ((*f = filealloc()) == 0)
     goto bad;
-  if ((si = (struct sock*)kalloc()) == 0)
+  if ((si = (struct sock*)kmem_cache_alloc(&sockcache)) == 0)
     goto bad;
 
   // initialize objects
@@ -74,7 +85,7 @@ sockalloc(struct file **f, uint32 raddr, uint16 lport, uint16 rport)
 
 bad:
   if (si)
-    kfree((char*)si);
+    kmem_cache_free(&sockcache, si);
   if (*f)
     fileclose(*f);
   return -1;
@@ -104,7 +115,7 @@ sockclose(struct sock *si)
     mbuffree(m);
   }
 
-  kfree((char*)si);
+  kmem_cache_free(&sockcache, si);
 }
 
 int
@@ -183,3 +194,38 @@ found:
   release(&si->lock);
   release(&lock);
 }
+
+// Shrinker: UDP may lose packets, so when memory runs out
+// drop everything but the oldest packet queued on each
+// socket. The mbufs go back to their caches, which the slab
+// shrinker turns into free pages on kalloc()'s next pass.
+// Returns the number of packets dropped.
+static int
+sockshrink(void)
+{
+  struct sock *si;
+  struct mbufq drop;
+  struct mbuf *m, *keep;
+  int n = 0;
+
+  mbufq_init(&drop);
+  acquire(&lock);
+  for (si = sockets; si; si = si->next) {
+    acquire(&si->lock);
+    if (!mbufq_empty(&si->rxq)) {
+      keep = mbufq_pophead(&si->rxq);
+      while (!mbufq_empty(&si->rxq))
+        mbufq_pushtail(&drop, mbufq_pophead(&si->rxq));
+      mbufq_pushtail(&si->rxq, keep);
+    }
+    release(&si->lock);
+  }
+  release(&lock);
+
+  while (!mbufq_empty(&drop)) {
+    m = mbufq_pophead(&drop);
+    mbuffree(m);
+    n++;
+  }
+  return n;
+}
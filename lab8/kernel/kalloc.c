@@ -1,6 +1,13 @@
 // Physical memory allocator, for user processes,
 // kernel stacks, page-table pages,
-// and pipe buffers. Allocates whole 4096-byte pages.
+// and pipe buffers. Allocates whole 4096-byte pages,
+// or physically contiguous runs of 2^order pages.
+//
+// All free memory lives in a binary buddy allocator;
+// each CPU keeps a small cache of single pages in front
+// of it so that kalloc()/kfree() rarely touch the buddy lock.
+// Each CPU also keeps freed page-table pages, which are already
+// zero, for kalloc_pt() to hand out again without a memset.
 
 #include "types.h"
 #include "param.h"
@@ -16,32 +23,193 @@ extern char end[]; // first address after kernel.
 
 struct run {
   struct run *next;
+  struct run *prev;  // 只有buddy的空闲链表使用
 };
 
+// 每个CPU缓存的空闲页数超过KMEM_HIGH时，一次性把多出KMEM_LOW的部分还给buddy；
+// 缓存为空时一次从buddy取KMEM_BATCH页，buddy也空时偷走别的CPU一半的缓存。
+#define KMEM_HIGH  64
+#define KMEM_LOW   16
+#define KMEM_BATCH 16
+#define PTCACHE_MAX 32  // 每个CPU最多缓存的页表页
+
 struct {
   struct spinlock lock;
   struct run *freelist;
+  int nfree;          // freelist中的页数
+  char lockname[8];   // 锁名需要一直有效，不能放在栈上
+  int nrefill;        // 从buddy批量取页的次数
+  int ndrain;         // 批量还给buddy的次数
+  int nsteal;         // 从其他CPU偷页的次数
+  int nstolen;        // 偷到的总页数
+  struct run *ptlist; // 缓存的页表页，除了next以外全是0
+  int npt;            // ptlist中的页数
+  int npthit;         // kalloc_pt()从ptlist拿到页的次数
+  int nptmiss;        // kalloc_pt()要从kalloc()拿页并清零的次数
 } kmem[NCPU];
 
+#define NPAGE ((PHYSTOP - KERNBASE) / PGSIZE)
+#define PA2IDX(pa) (((uint64)(pa) - KERNBASE) / PGSIZE)
+#define IDX2PA(i) (KERNBASE + (uint64)(i) * PGSIZE)
+#define NOTFREE 0xff
+
+// 以KERNBASE为起点编号，order为k的块在物理上按 PGSIZE<<k 对齐
+struct {
+  struct spinlock lock;
+  struct run *free[MAXORDER+1];  // 每个order一个双向空闲链表
+  int nfree[MAXORDER+1];         // 每个order的空闲块数
+  uchar order[NPAGE];            // 空闲块首页记录其order，其余为NOTFREE
+} buddy;
+
 void
 kinit()
 {
-  char lockname[8];
   for(int i = 0;i < NCPU; i++) {
     // 用字符串格式化初始锁的名字为kmem_1
-    snprintf(lockname, sizeof(lockname), "kmem_%d", i);
-    initlock(&kmem[i].lock, lockname);
+    snprintf(kmem[i].lockname, sizeof(kmem[i].lockname), "kmem_%d", i);
+    initlock(&kmem[i].lock, kmem[i].lockname);
   }
+  initlock(&buddy.lock, "kmem_buddy");
+  memset(buddy.order, NOTFREE, sizeof(buddy.order));
   freerange(end, (void*)PHYSTOP);
 }
 
 void
 freerange(void *pa_start, void *pa_end)
 {
-  char *p;
-  p = (char*)PGROUNDUP((uint64)pa_start);
-  for(; p + PGSIZE <= (char*)pa_end; p += PGSIZE)
-    kfree(p);
+  uint64 i, last;
+  int order;
+
+  i = PA2IDX(PGROUNDUP((uint64)pa_start));
+  last = PA2IDX(PGROUNDDOWN((uint64)pa_end));
+  // 每次放入能对齐且不越界的最大块
+  while(i < last){
+    order = MAXORDER;
+    while(order > 0 && ((i & ((1L << order) - 1)) != 0 || i + (1L << order) > last))
+      order--;
+    kfree_pages((void*)IDX2PA(i), order);
+    i += 1L << order;
+  }
+}
+
+static void
+buddy_push(uint64 idx, int order)
+{
+  struct run *r = (struct run*)IDX2PA(idx);
+
+  r->prev = 0;
+  r->next = buddy.free[order];
+  if(r->next)
+    r->next->prev = r;
+  buddy.free[order] = r;
+  buddy.nfree[order]++;
+  buddy.order[idx] = order;
+}
+
+static void
+buddy_remove(uint64 idx, int order)
+{
+  struct run *r = (struct run*)IDX2PA(idx);
+
+  if(r->prev)
+    r->prev->next = r->next;
+  else
+    buddy.free[order] = r->next;
+  if(r->next)
+    r->next->prev = r->prev;
+  buddy.nfree[order]--;
+  buddy.order[idx] = NOTFREE;
+}
+
+// 取出一个2^order页的块，必要时拆分更大的块。
+// 调用者持有buddy.lock。
+static void *
+buddy_take(int order)
+{
+  uint64 idx;
+  int k;
+
+  for(k = order; k <= MAXORDER; k++)
+    if(buddy.free[k])
+      break;
+  if(k > MAXORDER)
+    return 0;
+  idx = PA2IDX(buddy.free[k]);
+  buddy_remove(idx, k);
+  // 拆分后把后一半挂回低一级的链表
+  while(k > order){
+    k--;
+    buddy_push(idx + (1L << k), k);
+  }
+  return (void*)IDX2PA(idx);
+}
+
+// 归还一个块，并与空闲的伙伴逐级合并。
+// 调用者持有buddy.lock。
+static void
+buddy_give(void *pa, int order)
+{
+  uint64 idx, b;
+
+  idx = PA2IDX(pa);
+  while(order < MAXORDER){
+    b = idx ^ (1L << order);
+    if(b >= NPAGE || buddy.order[b] != order)
+      break;
+    buddy_remove(b, order);
+    idx &= ~(1L << order);
+    order++;
+  }
+  buddy_push(idx, order);
+}
+
+static void *
+buddy_alloc(int order)
+{
+  void *pa;
+
+  acquire(&buddy.lock);
+  pa = buddy_take(order);
+  release(&buddy.lock);
+  return pa;
+}
+
+static void
+buddy_free(void *pa, int order)
+{
+  acquire(&buddy.lock);
+  buddy_give(pa, order);
+  release(&buddy.lock);
+}
+
+// Allocate 2^order physically contiguous pages, aligned
+// to PGSIZE << order. Returns 0 if no such block is free.
+void *
+kalloc_pages(int order)
+{
+  void *pa;
+
+  if(order < 0 || order > MAXORDER)
+    return 0;
+  pa = buddy_alloc(order);
+  if(pa)
+    memset(pa, 5, PGSIZE << order); // fill with junk
+  return pa;
+}
+
+// Free a block returned by kalloc_pages(order).
+void
+kfree_pages(void *pa, int order)
+{
+  if(order < 0 || order > MAXORDER ||
+     ((uint64)pa % (PGSIZE << order)) != 0 ||
+     (char*)pa < end || (uint64)pa + (PGSIZE << order) > PHYSTOP)
+    panic("kfree_pages");
+
+  // Fill with junk to catch dangling refs.
+  memset(pa, 1, PGSIZE << order);
+
+  buddy_free(pa, order);
 }
 
 // Free the page of physical memory pointed at by v,
@@ -51,7 +219,7 @@ freerange(void *pa_start, void *pa_end)
 void
 kfree(void *pa)
 {
-  struct run *r;
+  struct run *r, *surplus;
 
   if(((uint64)pa % PGSIZE) != 0 || (char*)pa < end || (uint64)pa >= PHYSTOP)
     panic("kfree");
@@ -60,14 +228,129 @@ kfree(void *pa)
   memset(pa, 1, PGSIZE);
 
   r = (struct run*)pa;
+  surplus = 0;
 
   push_off();  // 关中断
   int id = cpuid();
   acquire(&kmem[id].lock);
   r->next = kmem[id].freelist;
   kmem[id].freelist = r;
+  kmem[id].nfree++;
+  if(kmem[id].nfree > KMEM_HIGH){
+    // 保留最近释放的KMEM_LOW页，其余整段摘下
+    r = kmem[id].freelist;
+    for(int i = 1; i < KMEM_LOW; i++)
+      r = r->next;
+    surplus = r->next;
+    r->next = 0;
+    kmem[id].nfree = KMEM_LOW;
+    kmem[id].ndrain++;
+  }
   release(&kmem[id].lock);
   pop_off();
+
+  // 在一次buddy加锁中归还并合并
+  if(surplus){
+    acquire(&buddy.lock);
+    while(surplus){
+      r = surplus;
+      surplus = r->next;
+      buddy_give(r, 0);
+    }
+    release(&buddy.lock);
+  }
+}
+
+// 从buddy一次取最多KMEM_BATCH页，返回其中一页，其余放进本CPU缓存。
+static struct run *
+kmem_refill(int id)
+{
+  struct run *r, *list, *tail;
+  int n;
+
+  list = tail = 0;
+  acquire(&buddy.lock);
+  for(n = 0; n < KMEM_BATCH; n++){
+    if((r = buddy_take(0)) == 0)
+      break;
+    r->next = list;
+    list = r;
+    if(tail == 0)
+      tail = r;
+  }
+  release(&buddy.lock);
+
+  if(list == 0)
+    return 0;
+  r = list;
+  acquire(&kmem[id].lock);
+  if(n > 1){
+    tail->next = kmem[id].freelist;
+    kmem[id].freelist = r->next;
+    kmem[id].nfree += n - 1;
+  }
+  kmem[id].nrefill++;
+  release(&kmem[id].lock);
+  return r;
+}
+
+// buddy已空，从其他CPU缓存一次偷走一半，返回其中一页，其余放进本CPU缓存。
+// 不持有自己的锁去拿别人的锁，避免两个CPU互相偷时死锁。
+static struct run *
+kmem_steal(int id)
+{
+  struct run *r, *tail;
+  int antid, n;
+
+  r = 0;
+  n = 0;
+  for(antid = 0; antid < NCPU; ++antid) {
+    if(antid == id)
+      continue;
+    acquire(&kmem[antid].lock);
+    if(kmem[antid].nfree > 0) {
+      n = (kmem[antid].nfree + 1) / 2;
+      r = tail = kmem[antid].freelist;
+      for(int i = 1; i < n; i++)
+        tail = tail->next;
+      kmem[antid].freelist = tail->next;
+      kmem[antid].nfree -= n;
+      tail->next = 0;
+      release(&kmem[antid].lock);
+      break;
+    }
+    release(&kmem[antid].lock);
+  }
+
+  if(r == 0)
+    return 0;
+  acquire(&kmem[id].lock);
+  if(n > 1){
+    tail->next = kmem[id].freelist;
+    kmem[id].freelist = r->next;
+    kmem[id].nfree += n - 1;
+  }
+  kmem[id].nsteal++;
+  kmem[id].nstolen += n;
+  release(&kmem[id].lock);
+  return r;
+}
+
+// 其他地方都没有空闲页了，拿一个缓存的页表页。
+static struct run *
+kmem_ptreclaim(void)
+{
+  struct run *r = 0;
+
+  for(int i = 0; i < NCPU && r == 0; i++){
+    acquire(&kmem[i].lock);
+    if((r = kmem[i].ptlist) != 0){
+      kmem[i].ptlist = r->next;
+      kmem[i].npt--;
+    }
+    release(&kmem[i].lock);
+  }
+  return r;
 }
 
 // Allocate one 4096-byte page of physical memory.
@@ -83,28 +366,119 @@ kalloc(void)
 
   acquire(&kmem[id].lock);
   r = kmem[id].freelist;
-  if(r)
+  if(r){
     kmem[id].freelist = r->next;
-  else{
-    int antid;  // another id
-    // 遍历所有CPU的空闲列表
-    for(antid = 0; antid < NCPU; ++antid) {
-      if(antid == id)
-        continue;
-      acquire(&kmem[antid].lock);
-      r = kmem[antid].freelist;
-      if(r) {
-        kmem[antid].freelist = r->next;
-        release(&kmem[antid].lock);
-        break;
-      }
-      release(&kmem[antid].lock);
-    }
+    kmem[id].nfree--;
   }
   release(&kmem[id].lock);
+
+  if(!r)
+    r = kmem_refill(id);
+  if(!r)
+    r = kmem_steal(id);
+  if(!r)
+    r = kmem_ptreclaim();
   pop_off();  //开中断
 
   if(r)
     memset((char*)r, 5, PGSIZE); // fill with junk
   return (void*)r;
 }
+
+// Allocate a zeroed page for a page table. Pages that
+// kfree_pt() cached on this CPU are already zero; otherwise
+// take a page from kalloc() and zero it now.
+void *
+kalloc_pt(void)
+{
+  struct run *r;
+
+  push_off();
+  int id = cpuid();
+  acquire(&kmem[id].lock);
+  if((r = kmem[id].ptlist) != 0){
+    kmem[id].ptlist = r->next;
+    kmem[id].npt--;
+    kmem[id].npthit++;
+  } else {
+    kmem[id].nptmiss++;
+  }
+  release(&kmem[id].lock);
+  pop_off();
+
+  if(r){
+    r->next = 0;   // 只有链表指针不是0
+    return (void*)r;
+  }
+  if((r = kalloc()) != 0)
+    memset(r, 0, PGSIZE);
+  return (void*)r;
+}
+
+// Free a page-table page. All of its PTEs must be zero,
+// as they are when freewalk() is done with it.
+void
+kfree_pt(void *pa)
+{
+  struct run *r = (struct run*)pa;
+
+  if(((uint64)pa % PGSIZE) != 0 || (char*)pa < end || (uint64)pa >= PHYSTOP)
+    panic("kfree_pt");
+
+  push_off();
+  int id = cpuid();
+  acquire(&kmem[id].lock);
+  if(kmem[id].npt < PTCACHE_MAX){
+    r->next = kmem[id].ptlist;
+    kmem[id].ptlist = r;
+    kmem[id].npt++;
+    r = 0;
+  }
+  release(&kmem[id].lock);
+  pop_off();
+
+  if(r)
+    kfree(r);
+}
+
+#ifdef LAB_LOCK
+// 统计信息：各CPU缓存页数与buddy各order的空闲块数
+int
+statskmem(char *buf, int sz)
+{
+  int n;
+
+  n = snprintf(buf, sz, "--- kmem stats\n");
+  n += snprintf(buf+n, sz-n, "percpu:");
+  for(int i = 0; i < NCPU; i++)
+    n += snprintf(buf+n, sz-n, " %d", kmem[i].nfree);
+  n += snprintf(buf+n, sz-n, "\nrefill:");
+  for(int i = 0; i < NCPU; i++)
+    n += snprintf(buf+n, sz-n, " %d", kmem[i].nrefill);
+  n += snprintf(buf+n, sz-n, "\ndrain:");
+  for(int i = 0; i < NCPU; i++)
+    n += snprintf(buf+n, sz-n, " %d", kmem[i].ndrain);
+  n += snprintf(buf+n, sz-n, "\nsteal:");
+  for(int i = 0; i < NCPU; i++)
+    n += snprintf(buf+n, sz-n, " %d/%d", kmem[i].nsteal, kmem[i].nstolen);
+  n += snprintf(buf+n, sz-n, "\nptcache:");
+  for(int i = 0; i < NCPU; i++)
+    n += snprintf(buf+n, sz-n, " %d", kmem[i].npt);
+  n += snprintf(buf+n, sz-n, "\npthit:");
+  int hit = 0, miss = 0;
+  for(int i = 0; i < NCPU; i++){
+    n += snprintf(buf+n, sz-n, " %d/%d", kmem[i].npthit, kmem[i].nptmiss);
+    hit += kmem[i].npthit;
+    miss += kmem[i].nptmiss;
+  }
+  if(hit + miss > 0)
+    n += snprintf(buf+n, sz-n, " (%d%% hit)", hit * 100 / (hit + miss));
+  n += snprintf(buf+n, sz-n, "\nbuddy:");
+  acquire(&buddy.lock);
+  for(int k = 0; k <= MAXORDER; k++)
+    n += snprintf(buf+n, sz-n, " %d", buddy.nfree[k]);
+  release(&buddy.lock);
+  n += snprintf(buf+n, sz-n, "\n");
+  return n;
+}
+#endif
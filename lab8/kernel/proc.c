@@ -160,6 +160,7 @@ freeproc(struct proc *p)
   p->pid = 0;
   p->parent = 0;
   p->name[0] = 0;
+  p->thp = 0;
   p->chan = 0;
   p->killed = 0;
   p->xstate = 0;
@@ -257,7 +258,11 @@ growproc(int n)
 
   sz = p->sz;
   if(n > 0){
-    if((sz = uvmalloc(p->pagetable, sz, sz + n)) == 0) {
+    if(p->thp)
+      sz = uvmallochuge(p->pagetable, sz, sz + n);
+    else
+      sz = uvmalloc(p->pagetable, sz, sz + n);
+    if(sz == 0) {
       return -1;
     }
   } else if(n < 0){
@@ -288,6 +293,7 @@ fork(void)
     return -1;
   }
   np->sz = p->sz;
+  np->thp = p->thp;
 
   // copy saved user registers.
   *(np->trapframe) = *(p->trapframe);
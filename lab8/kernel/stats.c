@@ -39,6 +39,7 @@ statsread(int user_dst, uint64 dst, int n)
 #endif
 #ifdef LAB_LOCK
     stats.sz = statslock(stats.buf, BUFSZ);
+    stats.sz += statskmem(stats.buf + stats.sz, BUFSZ - stats.sz);
 #endif
   }
   m = stats.sz - stats.off;
@@ -52,6 +52,20 @@ sys_sbrk(void)
   return addr;
 }
 
+// 打开或关闭本进程sbrk的大页模式，返回原来的设置
+uint64
+sys_hugepage(void)
+{
+  int on, old;
+  struct proc *p = myproc();
+
+  if(argint(0, &on) < 0)
+    return -1;
+  old = p->thp;
+  p->thp = (on != 0);
+  return old;
+}
+
 uint64
 sys_sleep(void)
 {
@@ -15,6 +15,8 @@ extern char etext[];  // kernel.ld sets this to end of kernel code.
 
 extern char trampoline[]; // trampoline.S
 
+#define MEGAORDER 9  // 一个大页 = 2^MEGAORDER个4KB页，用kalloc_pages分配
+
 // Make a direct-map page table for the kernel.
 pagetable_t
 kvmmake(void)
@@ -86,17 +88,79 @@ walk(pagetable_t pagetable, uint64 va, int alloc)
   for(int level = 2; level > 0; level--) {
     pte_t *pte = &pagetable[PX(level, va)];
     if(*pte & PTE_V) {
+      if(*pte & (PTE_R|PTE_W|PTE_X))
+        panic("walk: megapage");  // 大页要先用walkmega()处理
       pagetable = (pagetable_t)PTE2PA(*pte);
     } else {
-      if(!alloc || (pagetable = (pde_t*)kalloc()) == 0)
+      if(!alloc || (pagetable = (pde_t*)kalloc_pt()) == 0)
         return 0;
-      memset(pagetable, 0, PGSIZE);
       *pte = PA2PTE(pagetable) | PTE_V;
     }
   }
   return &pagetable[PX(0, va)];
 }
 
+// 如果va落在一个2MB大页中，返回那个level-1的叶子PTE，否则返回0
+static pte_t *
+walkmega(pagetable_t pagetable, uint64 va)
+{
+  pte_t *pte;
+
+  if(va >= MAXVA)
+    panic("walkmega");
+  pte = &pagetable[PX(2, va)];
+  if((*pte & PTE_V) == 0)
+    return 0;
+  pagetable = (pagetable_t)PTE2PA(*pte);
+  pte = &pagetable[PX(1, va)];
+  if((*pte & PTE_V) && (*pte & (PTE_R|PTE_W|PTE_X)))
+    return pte;
+  return 0;
+}
+
+// 用一个level-1叶子PTE把va开始的2MB映射到pa，两者都必须2MB对齐。
+// 如果该位置已有一个空的level-0页表就释放它；已有映射时返回-1。
+static int
+mapmega(pagetable_t pagetable, uint64 va, uint64 pa, int perm)
+{
+  pte_t *pte;
+  pagetable_t pt;
+
+  pte = &pagetable[PX(2, va)];
+  if(*pte & PTE_V){
+    pagetable = (pagetable_t)PTE2PA(*pte);
+  } else {
+    if((pagetable = (pde_t*)kalloc_pt()) == 0)
+      return -1;
+    *pte = PA2PTE(pagetable) | PTE_V;
+  }
+  pte = &pagetable[PX(1, va)];
+  if(*pte & PTE_V){
+    // sbrk缩小后留下的level-0页表可能还在
+    if(*pte & (PTE_R|PTE_W|PTE_X))
+      return -1;
+    pt = (pagetable_t)PTE2PA(*pte);
+    for(int i = 0; i < 512; i++)
+      if(pt[i] & PTE_V)
+        return -1;
+    kfree_pt(pt);
+  }
+  *pte = PA2PTE(pa) | perm | PTE_V;
+  return 0;
+}
+
+// 把大页拆成512个4KB页的level-0页表，pt是用作页表的空闲页。
+static void
+splitmega(pte_t *pte, pagetable_t pt)
+{
+  uint64 pa = PTE2PA(*pte);
+  int flags = PTE_FLAGS(*pte);
+
+  for(int i = 0; i < 512; i++)
+    pt[i] = PA2PTE(pa + i * PGSIZE) | flags;
+  *pte = PA2PTE(pt) | PTE_V;
+}
+
 // Look up a virtual address, return the physical address,
 // or 0 if not mapped.
 // Can only be used to look up user pages.
@@ -109,6 +173,11 @@ walkaddr(pagetable_t pagetable, uint64 va)
   if(va >= MAXVA)
     return 0;
 
+  if((pte = walkmega(pagetable, va)) != 0){
+    if((*pte & PTE_U) == 0)
+      return 0;
+    return PTE2PA(*pte) + (PGROUNDDOWN(va) & (MEGAPGSIZE - 1));
+  }
   pte = walk(pagetable, va, 0);
   if(pte == 0)
     return 0;
@@ -165,13 +234,36 @@ mappages(pagetable_t pagetable, uint64 va, uint64 size, uint64 pa, int perm)
 void
 uvmunmap(pagetable_t pagetable, uint64 va, uint64 npages, int do_free)
 {
-  uint64 a;
+  uint64 a, end;
   pte_t *pte;
+  pagetable_t pt;
 
   if((va % PGSIZE) != 0)
     panic("uvmunmap: not aligned");
 
-  for(a = va; a < va + npages*PGSIZE; a += PGSIZE){
+  end = va + npages*PGSIZE;
+  for(a = va; a < end; a += PGSIZE){
+    if((pte = walkmega(pagetable, a)) != 0){
+      if(a % MEGAPGSIZE == 0 && a + MEGAPGSIZE <= end){
+        // 整个大页都要解除映射
+        if(do_free)
+          kfree_pages((void*)PTE2PA(*pte), MEGAORDER);
+        *pte = 0;
+        a += MEGAPGSIZE - PGSIZE;
+        continue;
+      }
+      // 只解除一部分，先拆成4KB页。需要释放时直接拿a所在的页
+      // 当新页表，这样拆分不用分配内存，也就不会失败。
+      if(do_free){
+        pt = (pagetable_t)(PTE2PA(*pte) + (a & (MEGAPGSIZE - 1)));
+        splitmega(pte, pt);
+        pt[PX(0, a)] = 0;
+        continue;
+      }
+      if((pt = (pagetable_t)kalloc()) == 0)
+        panic("uvmunmap: split");
+      splitmega(pte, pt);
+    }
     if((pte = walk(pagetable, a, 0)) == 0)
       panic("uvmunmap: walk");
     if((*pte & PTE_V) == 0)
@@ -192,10 +284,9 @@ pagetable_t
 uvmcreate()
 {
   pagetable_t pagetable;
-  pagetable = (pagetable_t) kalloc();
+  pagetable = (pagetable_t) kalloc_pt();
   if(pagetable == 0)
     return 0;
-  memset(pagetable, 0, PGSIZE);
   return pagetable;
 }
 
@@ -243,6 +334,41 @@ uvmalloc(pagetable_t pagetable, uint64 oldsz, uint64 newsz)
   return newsz;
 }
 
+// 与uvmalloc相同，但每个完整落在[oldsz, newsz)内且2MB对齐的区域
+// 在有连续物理内存时用一个大页映射，其余部分仍用4KB页。
+uint64
+uvmallochuge(pagetable_t pagetable, uint64 oldsz, uint64 newsz)
+{
+  char *mem;
+  uint64 a, end;
+
+  if(newsz < oldsz)
+    return oldsz;
+
+  a = PGROUNDUP(oldsz);
+  while(a < newsz){
+    if(a % MEGAPGSIZE == 0 && a + MEGAPGSIZE <= newsz &&
+       (mem = kalloc_pages(MEGAORDER)) != 0){
+      memset(mem, 0, MEGAPGSIZE);
+      if(mapmega(pagetable, a, (uint64)mem, PTE_W|PTE_X|PTE_R|PTE_U) == 0){
+        a += MEGAPGSIZE;
+        continue;
+      }
+      kfree_pages(mem, MEGAORDER);
+    }
+    // 到下一个2MB边界为止用4KB页
+    end = (a + MEGAPGSIZE) & ~(MEGAPGSIZE - 1);
+    if(end > newsz)
+      end = newsz;
+    if(uvmalloc(pagetable, a, end) == 0){
+      uvmdealloc(pagetable, a, oldsz);
+      return 0;
+    }
+    a = PGROUNDUP(end);
+  }
+  return newsz;
+}
+
 // Deallocate user pages to bring the process size from oldsz to
 // newsz.  oldsz and newsz need not be page-aligned, nor does newsz
 // need to be less than oldsz.  oldsz can be larger than the actual
@@ -278,7 +404,7 @@ freewalk(pagetable_t pagetable)
       panic("freewalk: leaf");
     }
   }
-  kfree((void*)pagetable);
+  kfree_pt((void*)pagetable);
 }
 
 // Free user memory pages,
@@ -306,11 +432,24 @@ uvmcopy(pagetable_t old, pagetable_t new, uint64 sz)
   char *mem;
 
   for(i = 0; i < sz; i += PGSIZE){
-    if((pte = walk(old, i, 0)) == 0)
-      panic("uvmcopy: pte should exist");
-    if((*pte & PTE_V) == 0)
-      panic("uvmcopy: page not present");
-    pa = PTE2PA(*pte);
+    if((pte = walkmega(old, i)) != 0){
+      if(i % MEGAPGSIZE == 0 && (mem = kalloc_pages(MEGAORDER)) != 0){
+        memmove(mem, (char*)PTE2PA(*pte), MEGAPGSIZE);
+        if(mapmega(new, i, (uint64)mem, PTE_FLAGS(*pte)) == 0){
+          i += MEGAPGSIZE - PGSIZE;
+          continue;
+        }
+        kfree_pages(mem, MEGAORDER);
+      }
+      // 没有连续的2MB可用，子进程中拆成4KB页复制
+      pa = PTE2PA(*pte) + (i & (MEGAPGSIZE - 1));
+    } else {
+      if((pte = walk(old, i, 0)) == 0)
+        panic("uvmcopy: pte should exist");
+      if((*pte & PTE_V) == 0)
+        panic("uvmcopy: page not present");
+      pa = PTE2PA(*pte);
+    }
     flags = PTE_FLAGS(*pte);
     if((mem = kalloc()) == 0)
       goto err;
@@ -0,0 +1,144 @@
+#include "kernel/param.h"
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/riscv.h"
+#include "kernel/memlayout.h"
+#include "user/user.h"
+
+#define NCHILD 3
+#define ROUNDS 20
+#define NPG 1024   // 每个子进程每轮申请的页数
+#define SZ 4096
+
+void test1(void);
+void test2(void);
+char buf[SZ];
+
+int
+main(int argc, char *argv[])
+{
+  test1();
+  test2();
+  exit(0);
+}
+
+// 解析statistics中的"percpu:"、"ptcache:"和"buddy:"三行，
+// 返回各CPU缓存的页数（包括缓存的页表页）之和，nfree[k]为order k的空闲块数。
+int
+kmemstats(int *nfree)
+{
+  char *p, *line;
+  int n, k, cached = 0;
+
+  if((n = statistics(buf, SZ-1)) <= 0){
+    fprintf(2, "buddytest: no stats\n");
+    exit(-1);
+  }
+  buf[n] = 0;
+  for(line = buf; line && *line; line = p ? p + 1 : 0){
+    p = strchr(line, '\n');
+    if(p)
+      *p = 0;
+    if(memcmp(line, "percpu:", 7) == 0 || memcmp(line, "ptcache:", 8) == 0){
+      for(char *s = strchr(line, ':') + 1; *s; s++)
+        if(*s == ' ')
+          cached += atoi(s + 1);
+    } else if(memcmp(line, "buddy:", 6) == 0){
+      k = 0;
+      for(char *s = line + 6; *s && k <= MAXORDER; s++)
+        if(*s == ' ')
+          nfree[k++] = atoi(s + 1);
+    }
+  }
+  return cached;
+}
+
+int
+buddypages(int *nfree)
+{
+  int n = 0;
+  for(int k = 0; k <= MAXORDER; k++)
+    n += nfree[k] << k;
+  return n;
+}
+
+// 每个子进程反复申请、写入、释放NPG页，测吞吐量
+void
+churn(void)
+{
+  for(int i = 0; i < NCHILD; i++){
+    int pid = fork();
+    if(pid < 0){
+      printf("fork failed\n");
+      exit(-1);
+    }
+    if(pid == 0){
+      for(int r = 0; r < ROUNDS; r++){
+        char *a = sbrk(NPG * PGSIZE);
+        if(a == (char*)-1){
+          printf("sbrk failed\n");
+          exit(-1);
+        }
+        for(int j = 0; j < NPG; j++)
+          a[j * PGSIZE] = j;
+        sbrk(-NPG * PGSIZE);
+      }
+      exit(0);
+    }
+  }
+  for(int i = 0; i < NCHILD; i++){
+    int xstatus;
+    wait(&xstatus);
+    if(xstatus != 0)
+      exit(-1);
+  }
+}
+
+void
+test1(void)
+{
+  int t0, t1;
+
+  printf("start test1\n");
+  t0 = uptime();
+  churn();
+  t1 = uptime();
+  printf("test1: %d pages in %d ticks\n", NCHILD * ROUNDS * NPG, t1 - t0);
+  printf("test1 OK\n");
+}
+
+void
+test2(void)
+{
+  int nfree0[MAXORDER+1], nfree1[MAXORDER+1];
+  int free0, free1, nonbuddy;
+  int npage = (PHYSTOP - KERNBASE) / PGSIZE;
+
+  printf("start test2\n");
+  free0 = kmemstats(nfree0) + buddypages(nfree0);
+  churn();
+  free1 = kmemstats(nfree1) + buddypages(nfree1);
+  printf("buddy free blocks by order:");
+  for(int k = 0; k <= MAXORDER; k++)
+    printf(" %d", nfree1[k]);
+  printf("\n");
+
+  if(free1 != free0){
+    printf("test2 FAIL: %d free pages before, %d after\n", free0, free1);
+    exit(-1);
+  }
+  // 每个空闲块的伙伴里至少有一个不在buddy中的页，
+  // 如果释放时没有合并，小order的空闲块会远多于这些页。
+  nonbuddy = npage - buddypages(nfree1);
+  for(int k = 0; k < MAXORDER; k++){
+    if(nfree1[k] > nonbuddy){
+      printf("test2 FAIL: %d free blocks of order %d\n", nfree1[k], k);
+      exit(-1);
+    }
+  }
+  if(nfree1[MAXORDER] == 0){
+    printf("test2 FAIL: no free block of order %d\n", MAXORDER);
+    exit(-1);
+  }
+  printf("test2 OK\n");
+}
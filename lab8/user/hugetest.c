@@ -0,0 +1,97 @@
+#include "kernel/param.h"
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/riscv.h"
+#include "user/user.h"
+
+// 分别在4KB页和大页模式下sbrk一大块内存，
+// 测分配、顺序访问、随机访问的时间，并检查fork和部分缩小（拆分大页）后内容不变。
+
+#define NMEGA 8
+#define SZ (NMEGA * MEGAPGSIZE)
+#define NINT (SZ / sizeof(int))
+#define NRAND (1 << 20)
+
+static uint seed = 1;
+
+static uint
+rand(void)
+{
+  seed = seed * 1103515245 + 12345;
+  return seed >> 8;
+}
+
+void
+fail(char *msg)
+{
+  printf("hugetest: %s\n", msg);
+  exit(-1);
+}
+
+// 检查[0, n)中每页第一个int
+void
+check(int *a, uint n)
+{
+  for(uint i = 0; i < n; i += PGSIZE / sizeof(int))
+    if(a[i] != i)
+      fail("bad data");
+}
+
+void
+run(int huge)
+{
+  uint64 cur, pad;
+  int *a;
+  int t0, t1, t2, t3;
+
+  hugepage(huge);
+  cur = (uint64)sbrk(0);
+  pad = (MEGAPGSIZE - cur % MEGAPGSIZE) % MEGAPGSIZE;
+  if(sbrk(pad) == (char*)-1)
+    fail("sbrk pad failed");
+
+  t0 = uptime();
+  a = (int*)sbrk(SZ);
+  if(a == (int*)-1)
+    fail("sbrk failed");
+  t1 = uptime();
+  for(uint i = 0; i < NINT; i++)
+    a[i] = i;
+  t2 = uptime();
+  for(int i = 0; i < NRAND; i++){
+    uint j = rand() % NINT;
+    if(a[j] != j)
+      fail("bad random read");
+  }
+  t3 = uptime();
+  printf("%s: sbrk %d, sequential %d, random %d ticks\n",
+         huge ? "huge" : "4k", t1 - t0, t2 - t1, t3 - t2);
+
+  // fork要复制（或拆开复制）大页
+  int pid = fork();
+  if(pid < 0)
+    fail("fork failed");
+  if(pid == 0){
+    check(a, NINT);
+    exit(0);
+  }
+  int xstatus;
+  wait(&xstatus);
+  if(xstatus != 0)
+    exit(-1);
+
+  // 缩小半个大页，最后一个大页要被拆分
+  sbrk(-(MEGAPGSIZE / 2));
+  check(a, NINT - MEGAPGSIZE / 2 / sizeof(int));
+  sbrk(-(int)(SZ - MEGAPGSIZE / 2 + pad));
+  hugepage(0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  run(0);
+  run(1);
+  printf("hugetest OK\n");
+  exit(0);
+}
@@ -0,0 +1,86 @@
+#include "kernel/param.h"
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+// 反复fork+exec+exit，每一轮都要建立并释放好几棵页表，
+// 之后从statistics中取出页表页缓存的命中情况。
+
+#define NROUND 200
+#define SZ 4096
+
+char buf[SZ];
+
+// 返回statistics中"pthit:"一行各CPU命中次数与未命中次数之和
+void
+pthits(int *hit, int *miss)
+{
+  char *line, *p, *s;
+  int n;
+
+  *hit = *miss = 0;
+  if((n = statistics(buf, SZ-1)) <= 0){
+    fprintf(2, "ptcachetest: no stats\n");
+    exit(-1);
+  }
+  buf[n] = 0;
+  for(line = buf; line && *line; line = p ? p + 1 : 0){
+    p = strchr(line, '\n');
+    if(p)
+      *p = 0;
+    if(memcmp(line, "pthit:", 6) != 0)
+      continue;
+    for(s = line + 6; *s == ' '; ){
+      *hit += atoi(s + 1);
+      s = strchr(s, '/');
+      *miss += atoi(s + 1);
+      while(*s && *s != ' ')
+        s++;
+      if(*s == 0 || s[1] == '(')
+        break;
+    }
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  int hit0, miss0, hit1, miss1, t0, t1;
+  char *args[] = { "ptcachetest", "child", 0 };
+
+  if(argc > 1)
+    exit(0);   // exec出来的子进程，直接退出
+
+  pthits(&hit0, &miss0);
+  t0 = uptime();
+  for(int i = 0; i < NROUND; i++){
+    int pid = fork();
+    if(pid < 0){
+      printf("ptcachetest: fork failed\n");
+      exit(-1);
+    }
+    if(pid == 0){
+      exec(args[0], args);
+      printf("ptcachetest: exec failed\n");
+      exit(-1);
+    }
+    int xstatus;
+    wait(&xstatus);
+    if(xstatus != 0)
+      exit(-1);
+  }
+  t1 = uptime();
+  pthits(&hit1, &miss1);
+
+  hit1 -= hit0;
+  miss1 -= miss0;
+  printf("ptcachetest: %d fork+exec+exit in %d ticks, %d page-table pages cached, %d not\n",
+         NROUND, t1 - t0, hit1, miss1);
+  // 除了最开始几轮，页表页都应该来自缓存
+  if(hit1 <= miss1){
+    printf("ptcachetest: FAIL\n");
+    exit(-1);
+  }
+  printf("ptcachetest: OK\n");
+  exit(0);
+}
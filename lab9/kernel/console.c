@@ -109,8 +109,14 @@ consoleread(int user_dst, uint64 dst, int n)
 
     // copy the input byte to the user-space buffer.
     cbuf = c;
-    if(either_copyout(user_dst, dst, &cbuf, 1) == -1)
-      break;
+    if(either_copyout(user_dst, dst, &cbuf, 1) == -1){
+      // 目标页可能被换出了，放开锁把它换进来再拷
+      release(&cons.lock);
+      int ok = user_dst && uvmresident(myproc()->pagetable, dst, 1) == 0;
+      acquire(&cons.lock);
+      if(!ok || either_copyout(user_dst, dst, &cbuf, 1) == -1)
+        break;
+    }
 
     dst++;
     --n;
@@ -0,0 +1,161 @@
+// Memory block operations, shared by the kernel and by
+// user programs (linked into ULIB).
+//
+// Once the pointers are 8-byte aligned they move whole
+// words, four per loop iteration; a misaligned head or
+// tail, or buffers whose alignments differ, go a byte at
+// a time.
+
+#include "types.h"
+
+#define WSIZE 8
+#define WMASK (WSIZE - 1)
+#define ALIGNED(p) (((uint64)(p) & WMASK) == 0)
+
+void*
+memset(void *dst, int c, uint n)
+{
+  uchar *d = dst;
+  uint64 w, *wd;
+
+  while(n > 0 && !ALIGNED(d)){
+    *d++ = c;
+    n--;
+  }
+  if(n >= WSIZE){
+    // c复制到一个字的每个字节
+    w = (uchar)c;
+    w |= w << 8;
+    w |= w << 16;
+    w |= w << 32;
+    wd = (uint64*)d;
+    for(; n >= 4*WSIZE; n -= 4*WSIZE, wd += 4){
+      wd[0] = w;
+      wd[1] = w;
+      wd[2] = w;
+      wd[3] = w;
+    }
+    for(; n >= WSIZE; n -= WSIZE)
+      *wd++ = w;
+    d = (uchar*)wd;
+  }
+  while(n-- > 0)
+    *d++ = c;
+  return dst;
+}
+
+int
+memcmp(const void *v1, const void *v2, uint n)
+{
+  const uchar *s1, *s2;
+
+  s1 = v1;
+  s2 = v2;
+  if(ALIGNED((uint64)s1 ^ (uint64)s2)){
+    while(n > 0 && !ALIGNED(s1)){
+      if(*s1 != *s2)
+        return *s1 - *s2;
+      s1++, s2++, n--;
+    }
+    // 跳过相同的字，不同的那个字留给下面逐字节找出差别
+    for(; n >= WSIZE; s1 += WSIZE, s2 += WSIZE, n -= WSIZE)
+      if(*(uint64*)s1 != *(uint64*)s2)
+        break;
+  }
+  while(n-- > 0){
+    if(*s1 != *s2)
+      return *s1 - *s2;
+    s1++, s2++;
+  }
+
+  return 0;
+}
+
+// Copy forward, low addresses first.
+static void
+copyfwd(uchar *d, const uchar *s, uint n)
+{
+  uint64 w0, w1, w2, w3;
+
+  if(ALIGNED((uint64)d ^ (uint64)s)){
+    while(n > 0 && !ALIGNED(d)){
+      *d++ = *s++;
+      n--;
+    }
+    // 先读完四个字再写，即使dst与src重叠也不会覆盖还没读的数据
+    for(; n >= 4*WSIZE; n -= 4*WSIZE, d += 4*WSIZE, s += 4*WSIZE){
+      w0 = ((uint64*)s)[0];
+      w1 = ((uint64*)s)[1];
+      w2 = ((uint64*)s)[2];
+      w3 = ((uint64*)s)[3];
+      ((uint64*)d)[0] = w0;
+      ((uint64*)d)[1] = w1;
+      ((uint64*)d)[2] = w2;
+      ((uint64*)d)[3] = w3;
+    }
+    for(; n >= WSIZE; n -= WSIZE, d += WSIZE, s += WSIZE)
+      *(uint64*)d = *(uint64*)s;
+  }
+  while(n-- > 0)
+    *d++ = *s++;
+}
+
+// Copy backward, high addresses first, for when dst
+// overlaps the end of src. d and s point just past the
+// buffers.
+static void
+copybwd(uchar *d, const uchar *s, uint n)
+{
+  uint64 w0, w1, w2, w3;
+
+  if(ALIGNED((uint64)d ^ (uint64)s)){
+    while(n > 0 && !ALIGNED(d)){
+      *--d = *--s;
+      n--;
+    }
+    for(; n >= 4*WSIZE; n -= 4*WSIZE){
+      d -= 4*WSIZE;
+      s -= 4*WSIZE;
+      w3 = ((uint64*)s)[3];
+      w2 = ((uint64*)s)[2];
+      w1 = ((uint64*)s)[1];
+      w0 = ((uint64*)s)[0];
+      ((uint64*)d)[3] = w3;
+      ((uint64*)d)[2] = w2;
+      ((uint64*)d)[1] = w1;
+      ((uint64*)d)[0] = w0;
+    }
+    for(; n >= WSIZE; n -= WSIZE){
+      d -= WSIZE;
+      s -= WSIZE;
+      *(uint64*)d = *(uint64*)s;
+    }
+  }
+  while(n-- > 0)
+    *--d = *--s;
+}
+
+void*
+memmove(void *dst, const void *src, uint n)
+{
+  const uchar *s;
+  uchar *d;
+
+  s = src;
+  d = dst;
+  if(n == 0 || s == d)
+    return dst;
+  if(s < d && s + n > d)
+    copybwd(d + n, s + n, n);
+  else
+    copyfwd(d, s, n);
+
+  return dst;
+}
+
+// memcpy exists to placate GCC.  Use memmove.
+void*
+memcpy(void *dst, const void *src, uint n)
+{
+  return memmove(dst, src, n);
+}
@@ -65,3 +65,8 @@
 //   TRAPFRAME (p->trapframe, used by the trampoline)
 //   TRAMPOLINE (the same page as in the kernel)
 #define TRAPFRAME (TRAMPOLINE - PGSIZE)
+
+// each CPU's kernel page table shows the user memory of the
+// process it runs at USERWIN + va, using the upper half of
+// the Sv39 address space (root entries 256..511).
+#define USERWIN (-(1L << 38))
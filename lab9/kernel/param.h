@@ -15,13 +15,16 @@
 #define NBUF         (MAXOPBLOCKS*3)  // size of disk block cache
 #ifdef LAB_FS
 #define FSSIZE       200000  // size of file system in blocks
+#define NSWAPPAGE    4096    // pages in /swapfile
 #else
 #ifdef LAB_LOCK
 #define FSSIZE       10000  // size of file system in blocks
 #else
 #define FSSIZE       2000   // size of file system in blocks
 #endif
+#define NSWAPPAGE    0       // no room for /swapfile
 #endif
 #define MAXPATH      128   // maximum file path name
+#define FAULTAROUND  8     // pages mapped per lazy sbrk page fault
 
 
@@ -73,6 +73,21 @@ pipeclose(struct pipe *pi, int writable)
     release(&pi->lock);
 }
 
+// How many bytes to copy at once starting at index off of the
+// ring buffer: no more than avail or want, and not past the
+// end of data[].
+static int
+chunk(uint off, uint avail, int want)
+{
+  uint m = PIPESIZE - off % PIPESIZE;
+
+  if(m > avail)
+    m = avail;
+  if(m > want)
+    m = want;
+  return m;
+}
+
 int
 pipewrite(struct pipe *pi, uint64 addr, int n)
 {
@@ -89,11 +104,19 @@ pipewrite(struct pipe *pi, uint64 addr, int n)
       wakeup(&pi->nread);
       sleep(&pi->nwrite, &pi->lock);
     } else {
-      char ch;
-      if(copyin(pr->pagetable, &ch, addr + i, 1) == -1)
-        break;
-      pi->data[pi->nwrite++ % PIPESIZE] = ch;
-      i++;
+      // 一次拷贝缓冲区里连续的空闲部分
+      int m = chunk(pi->nwrite, pi->nread + PIPESIZE - pi->nwrite, n - i);
+      if(copyin(pr->pagetable, &pi->data[pi->nwrite % PIPESIZE], addr + i, m) == -1){
+        // 用户页可能被换出了：持锁时不能等磁盘，放开锁换进来再试
+        release(&pi->lock);
+        int ok = uvmresident(pr->pagetable, addr + i, m) == 0;
+        acquire(&pi->lock);
+        if(!ok)
+          break;
+        continue;
+      }
+      pi->nwrite += m;
+      i += m;
     }
   }
   wakeup(&pi->nread);
@@ -105,9 +128,8 @@ pipewrite(struct pipe *pi, uint64 addr, int n)
 int
 piperead(struct pipe *pi, uint64 addr, int n)
 {
-  int i;
+  int i, m;
   struct proc *pr = myproc();
-  char ch;
 
   acquire(&pi->lock);
   while(pi->nread == pi->nwrite && pi->writeopen){  //DOC: pipe-empty
@@ -117,12 +139,21 @@ piperead(struct pipe *pi, uint64 addr, int n)
     }
     sleep(&pi->nread, &pi->lock); //DOC: piperead-sleep
   }
-  for(i = 0; i < n; i++){  //DOC: piperead-copy
+  for(i = 0; i < n; i += m){  //DOC: piperead-copy
     if(pi->nread == pi->nwrite)
       break;
-    ch = pi->data[pi->nread++ % PIPESIZE];
-    if(copyout(pr->pagetable, addr + i, &ch, 1) == -1)
-      break;
+    m = chunk(pi->nread, pi->nwrite - pi->nread, n - i);
+    if(copyout(pr->pagetable, addr + i, &pi->data[pi->nread % PIPESIZE], m) == -1){
+      // 同pipewrite，放开锁把目标页换进来再试
+      release(&pi->lock);
+      int ok = uvmresident(pr->pagetable, addr + i, m) == 0;
+      acquire(&pi->lock);
+      if(!ok)
+        break;
+      m = 0;
+      continue;
+    }
+    pi->nread += m;
   }
   wakeup(&pi->nwrite);  //DOC: piperead-wakeup
   release(&pi->lock);
@@ -26,6 +26,9 @@ extern char trampoline[]; // trampoline.S
 // must be acquired before any p->lock.
 struct spinlock wait_lock;
 
+// 根页表中只映射用户内存的项数，最后一项映射trampoline和trapframe
+#define NUSERPDE PX(2, TRAPFRAME)
+
 // Allocate a page for each process's kernel stack.
 // Map it high in memory, followed by an invalid
 // guard page.
@@ -163,6 +166,7 @@ freeproc(struct proc *p)
   p->chan = 0;
   p->killed = 0;
   p->xstate = 0;
+  p->clockhand = 0;
   p->state = UNUSED;
 }
 
@@ -252,14 +256,15 @@ userinit(void)
 int
 growproc(int n)
 {
-  uint sz;
+  uint64 sz;
   struct proc *p = myproc();
 
   sz = p->sz;
   if(n > 0){
-    if((sz = uvmalloc(p->pagetable, sz, sz + n)) == 0) {
+    // lazy: 只扩大sz，页在第一次访问时由uvmlazy()分配
+    if(sz + n > TRAPFRAME)
       return -1;
-    }
+    sz += n;
   } else if(n < 0){
     sz = uvmdealloc(p->pagetable, sz, sz + n);
   }
@@ -282,7 +287,12 @@ fork(void)
   }
 
   // Copy user memory from parent to child.
-  if(uvmcopy(p->pagetable, np->pagetable, p->sz) < 0){
+  // uvmcopy()可能换出页或从交换区读页而睡眠，不能拿着np->lock；
+  // np还没有父进程，也不是RUNNABLE，这期间没人会动它
+  release(&np->lock);
+  i = uvmcopy(p->pagetable, np->pagetable, p->sz);
+  acquire(&np->lock);
+  if(i < 0){
     freeproc(np);
     release(&np->lock);
     return -1;
@@ -318,6 +328,80 @@ fork(void)
   return pid;
 }
 
+// Like fork(), but the child borrows the parent's user memory
+// instead of copying it: the user part of its root page table
+// points at the parent's lower-level page tables. The parent
+// sleeps until the child gives the memory back in exec() or
+// exit(), so the child must do little more than call those.
+int
+vfork(void)
+{
+  int i, pid;
+  struct proc *np;
+  struct proc *p = myproc();
+
+  if((np = allocproc()) == 0){
+    return -1;
+  }
+
+  // 根页表中映射用户内存的项直接抄父进程的，不复制任何页
+  for(i = 0; i < NUSERPDE; i++)
+    np->pagetable[i] = p->pagetable[i];
+  np->sz = p->sz;
+  np->vforkparent = p;
+
+  *(np->trapframe) = *(p->trapframe);
+  np->trapframe->a0 = 0;
+
+  for(i = 0; i < NOFILE; i++)
+    if(p->ofile[i])
+      np->ofile[i] = filedup(p->ofile[i]);
+  np->cwd = idup(p->cwd);
+
+  safestrcpy(np->name, p->name, sizeof(p->name));
+
+  pid = np->pid;
+
+  release(&np->lock);
+
+  acquire(&wait_lock);
+  np->parent = p;
+  release(&wait_lock);
+
+  acquire(&np->lock);
+  np->state = RUNNABLE;
+  release(&np->lock);
+
+  // 子进程在exec或exit之前一直在用我们的内存
+  acquire(&wait_lock);
+  while(np->vforkparent == p)
+    sleep(np, &wait_lock);
+  release(&wait_lock);
+
+  return pid;
+}
+
+// Called by a vfork() child in exec() or exit(): hand the
+// borrowed memory (root entries of pagetable, and its size)
+// back to the parent and wake it up.
+void
+vforkrelease(struct proc *p, pagetable_t pagetable, uint64 sz)
+{
+  struct proc *pp = p->vforkparent;
+
+  // 子进程可能sbrk过，根页表项和大小都要抄回去
+  for(int i = 0; i < NUSERPDE; i++){
+    pp->pagetable[i] = pagetable[i];
+    pagetable[i] = 0;
+  }
+  pp->sz = sz;
+
+  acquire(&wait_lock);
+  p->vforkparent = 0;
+  wakeup(p);
+  release(&wait_lock);
+}
+
 // Pass p's abandoned children to init.
 // Caller must hold wait_lock.
 void
@@ -344,6 +428,11 @@ exit(int status)
   if(p == initproc)
     panic("init exiting");
 
+  if(p->vforkparent){
+    vforkrelease(p, p->pagetable, p->sz);
+    p->sz = 0;
+  }
+
   // Close all open files.
   for(int fd = 0; fd < NOFILE; fd++){
     if(p->ofile[fd]){
@@ -387,6 +476,11 @@ wait(uint64 addr)
   int havekids, pid;
   struct proc *p = myproc();
 
+  // 下面持锁copyout，不能等磁盘换入，所以先把目标页换进来；
+  // 只有本进程会换出自己的页，等待期间它不会再被换出
+  if(addr != 0)
+    uvmresident(p->pagetable, addr, sizeof(int));
+
   acquire(&wait_lock);
 
   for(;;){
@@ -458,6 +552,7 @@ scheduler(void)
         // Process is done running for now.
         // It should have changed its p->state before coming back.
         c->proc = 0;
+        c->uwin = 0;
       }
       release(&p->lock);
     }
@@ -518,6 +613,7 @@ forkret(void)
     // be run from main().
     first = 0;
     fsinit(ROOTDEV);
+    swapinit();
   }
 
   usertrapret();
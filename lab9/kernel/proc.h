@@ -24,6 +24,7 @@ struct cpu {
   struct context context;     // swtch() here to enter scheduler().
   int noff;                   // Depth of push_off() nesting.
   int intena;                 // Were interrupts enabled before push_off()?
+  pagetable_t uwin;           // User page table shown in the user window, or 0.
 };
 
 extern struct cpu cpus[NCPU];
@@ -105,4 +106,6 @@ struct proc {
   struct file *ofile[NOFILE];  // Open files
   struct inode *cwd;           // Current directory
   char name[16];               // Process name (debugging)
+  struct proc *vforkparent;    // 借用其内存的父进程，exec或exit时归还
+  uint64 clockhand;            // 换出时CLOCK扫描的下一个虚拟地址
 };
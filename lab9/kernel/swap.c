@@ -0,0 +1,198 @@
+// Paging user memory out to /swapfile.
+//
+// mkfs lays /swapfile out on contiguous disk blocks. swapinit()
+// checks this and keeps the inode referenced so that the blocks
+// stay allocated. Slot s is the page at block start + s*BPP.
+// Swap I/O bypasses both the log and the buffer cache: each page
+// moves in one virtio request, straight from or to the page.
+//
+// A swapped-out PTE has PTE_V clear and PTE_SWAP set. It keeps
+// its other flags and holds the slot number where the PPN would be.
+//
+// Replacement is local. When a process cannot get a page, it
+// evicts one of its own, chosen by a CLOCK scan over PTE_A from
+// p->clockhand. Only the process itself changes its page table
+// (or a vfork child sharing it while the parent sleeps), so no
+// other CPU can be using a PTE that is being swapped.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "proc.h"
+#include "fs.h"
+#include "buf.h"
+#include "file.h"
+#include "defs.h"
+
+#define BPP (PGSIZE / BSIZE)   // blocks per page
+#define PTE2SLOT(pte) ((pte) >> 10)
+#define SLOT2PTE(s) ((uint64)(s) << 10)
+
+struct {
+  struct spinlock lock;   // protects used[]
+  struct sleeplock io;    // one transfer at a time, through buf
+  struct buf buf;         // what virtio_disk_rwn() waits on
+  struct inode *ip;       // /swapfile, kept referenced
+  uint start;             // first block of the swap area
+  int nslot;              // pages in the swap area, 0 if none
+  char used[NSWAPPAGE + 1];
+} swap;
+
+// Find /swapfile. Must run in process context, after fsinit().
+void
+swapinit(void)
+{
+  struct inode *ip;
+  uint i, n;
+
+  initlock(&swap.lock, "swap");
+  initsleeplock(&swap.io, "swapio");
+  if(NSWAPPAGE == 0)
+    return;
+
+  begin_op();
+  if((ip = namei("/swapfile")) == 0){
+    end_op();
+    printf("swap: no /swapfile\n");
+    return;
+  }
+  ilock(ip);
+  n = ip->size / BSIZE;
+  if(n > NSWAPPAGE * BPP)
+    n = NSWAPPAGE * BPP;
+  swap.start = bmap(ip, 0);
+  // 一个slot要能用一次请求读写，所以只用开头连续的那段
+  for(i = 1; i < n; i++)
+    if(bmap(ip, i) != swap.start + i)
+      break;
+  iunlock(ip);
+  end_op();
+
+  swap.ip = ip;
+  swap.nslot = i / BPP;
+  printf("swap: %d pages at block %d\n", swap.nslot, swap.start);
+}
+
+static int
+slotalloc(void)
+{
+  acquire(&swap.lock);
+  for(int i = 0; i < swap.nslot; i++){
+    if(swap.used[i] == 0){
+      swap.used[i] = 1;
+      release(&swap.lock);
+      return i;
+    }
+  }
+  release(&swap.lock);
+  return -1;
+}
+
+static void
+slotfree(int slot)
+{
+  acquire(&swap.lock);
+  if(slot >= swap.nslot || swap.used[slot] == 0)
+    panic("slotfree");
+  swap.used[slot] = 0;
+  release(&swap.lock);
+}
+
+// Move one page between memory and a swap slot.
+static void
+swapio(int slot, char *mem, int write)
+{
+  acquiresleep(&swap.io);
+  swap.buf.blockno = swap.start + slot * BPP;
+  virtio_disk_rwn(&swap.buf, mem, PGSIZE, write);
+  releasesleep(&swap.io);
+}
+
+// Evict one of the user pages below sz in pagetable, chosen
+// by a CLOCK scan that starts at *hand: a page whose PTE_A is
+// set gets a second chance and has the bit cleared. Returns 0
+// if a page was freed, or -1 if there was nothing to evict or
+// the swap area is full.
+int
+swapout(pagetable_t pagetable, uint64 sz, uint64 *hand)
+{
+  uint64 va, pa, npages = PGROUNDUP(sz) / PGSIZE;
+  pte_t *pte = 0;
+  int slot;
+
+  if(npages == 0 || (slot = slotalloc()) < 0)
+    return -1;
+  if(*hand >= sz)
+    *hand = 0;
+  // 第一圈清掉所有PTE_A，第二圈一定能找到
+  for(uint64 i = 0; i < 2 * npages; i++){
+    va = *hand;
+    *hand = va + PGSIZE < sz ? va + PGSIZE : 0;
+    pte = walk(pagetable, va, 0);
+    if(pte == 0 || (*pte & (PTE_V | PTE_U)) != (PTE_V | PTE_U)){
+      pte = 0;
+      continue;
+    }
+    if(*pte & PTE_A){
+      *pte &= ~PTE_A;
+      pte = 0;
+      continue;
+    }
+    break;
+  }
+  if(pte == 0){
+    slotfree(slot);
+    return -1;
+  }
+
+  // 写盘时本进程在内核里等着，不会访问这一页
+  pa = PTE2PA(*pte);
+  swapio(slot, (char*)pa, 1);
+  *pte = SLOT2PTE(slot) | (PTE_FLAGS(*pte) & ~(PTE_V | PTE_A | PTE_D)) | PTE_SWAP;
+  uwinflush(pagetable);
+  kfree((void*)pa);
+  return 0;
+}
+
+// Bring the swapped-out page at va back into memory.
+// Returns 0 on success, -1 if va is not swapped out or
+// there is no memory.
+int
+swapin(pagetable_t pagetable, uint64 va)
+{
+  pte_t *pte;
+  char *mem;
+  int slot;
+
+  // 先分配：uvmkalloc()可能还要换出别的页
+  if((mem = uvmkalloc()) == 0)
+    return -1;
+  pte = walk(pagetable, va, 0);
+  if(pte == 0 || (*pte & PTE_SWAP) == 0){
+    kfree(mem);
+    return -1;
+  }
+  slot = PTE2SLOT(*pte);
+  swapio(slot, mem, 0);
+  *pte = PA2PTE(mem) | (PTE_FLAGS(*pte) & ~PTE_SWAP) | PTE_V;
+  slotfree(slot);
+  return 0;
+}
+
+// Read the contents of the swapped-out page pte into mem,
+// leaving it in swap; fork() uses this to copy it.
+void
+swapread(pte_t pte, char *mem)
+{
+  swapio(PTE2SLOT(pte), mem, 0);
+}
+
+// The swapped-out page pte is no longer needed.
+void
+swapdrop(pte_t pte)
+{
+  slotfree(PTE2SLOT(pte));
+}
@@ -20,4 +20,5 @@
 #define SYS_link   19
 #define SYS_mkdir  20
 #define SYS_close  21
-#define SYS_symlink 22
\ No newline at end of file
+#define SYS_symlink 22
+#define SYS_vfork  23
\ No newline at end of file
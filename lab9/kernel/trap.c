@@ -15,6 +15,7 @@ extern char trampoline[], uservec[], userret[];
 void kernelvec();
 
 extern int devintr();
+static int pagefault(struct proc*, uint64);
 
 void
 trapinit(void)
@@ -67,6 +68,9 @@ usertrap(void)
     syscall();
   } else if((which_dev = devintr()) != 0){
     // ok
+  } else if((r_scause() == 12 || r_scause() == 13 || r_scause() == 15) &&
+            pagefault(p, r_stval()) == 0){
+    // 换入了页或lazy sbrk的页已分配
   } else {
     printf("usertrap(): unexpected scause %p pid=%d\n", r_scause(), p->pid);
     printf("            sepc=%p stval=%p\n", r_sepc(), r_stval());
@@ -137,13 +141,17 @@ kerneltrap()
   uint64 sepc = r_sepc();
   uint64 sstatus = r_sstatus();
   uint64 scause = r_scause();
+  uint64 fixup;
   
   if((sstatus & SSTATUS_SPP) == 0)
     panic("kerneltrap: not from supervisor mode");
   if(intr_get() != 0)
     panic("kerneltrap: interrupts enabled");
 
-  if((which_dev = devintr()) == 0){
+  if((scause == 13 || scause == 15) && (fixup = ufault(sepc, r_stval())) != 0){
+    // copyin/copyout碰到了坏的或尚未分配的用户地址
+    sepc = fixup;
+  } else if((which_dev = devintr()) == 0){
     printf("scause %p\n", scause);
     printf("sepc=%p stval=%p\n", r_sepc(), r_stval());
     panic("kerneltrap");
@@ -159,6 +167,16 @@ kerneltrap()
   w_sstatus(sstatus);
 }
 
+// A page fault from user space: swap the page in or allocate
+// it. That may wait for the disk, so turn interrupts on, as
+// for a system call; scause and stval have been read already.
+static int
+pagefault(struct proc *p, uint64 va)
+{
+  intr_on();
+  return uvmfault(p->pagetable, p->sz, va);
+}
+
 void
 clockintr()
 {
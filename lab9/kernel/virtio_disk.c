@@ -200,8 +200,11 @@ alloc3_desc(int *idx)
   return 0;
 }
 
+// Read or write n bytes at data, starting at block b->blockno.
+// b's own data is not used; b is only what the caller waits on.
+// data must be physically contiguous, e.g. one kalloc() page.
 void
-virtio_disk_rw(struct buf *b, int write)
+virtio_disk_rwn(struct buf *b, void *data, uint n, int write)
 {
   uint64 sector = b->blockno * (BSIZE / 512);
 
@@ -237,8 +240,8 @@ virtio_disk_rw(struct buf *b, int write)
   disk.desc[idx[0]].flags = VRING_DESC_F_NEXT;
   disk.desc[idx[0]].next = idx[1];
 
-  disk.desc[idx[1]].addr = (uint64) b->data;
-  disk.desc[idx[1]].len = BSIZE;
+  disk.desc[idx[1]].addr = (uint64) data;
+  disk.desc[idx[1]].len = n;
   if(write)
     disk.desc[idx[1]].flags = 0; // device reads b->data
   else
@@ -279,6 +282,12 @@ virtio_disk_rw(struct buf *b, int write)
   release(&disk.vdisk_lock);
 }
 
+void
+virtio_disk_rw(struct buf *b, int write)
+{
+  virtio_disk_rwn(b, b->data, BSIZE, write);
+}
+
 void
 virtio_disk_intr()
 {
@@ -3,6 +3,8 @@
 #include "memlayout.h"
 #include "elf.h"
 #include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
 #include "defs.h"
 #include "fs.h"
 
@@ -11,10 +13,26 @@
  */
 pagetable_t kernel_pagetable;
 
+// each CPU's copy of the kernel's root page-table page, whose
+// upper half is the user window (see USERWIN).
+pagetable_t cpupagetable[NCPU];
+
+#define UWINPX PX(2, USERWIN)
+#define NUWINPDE (MAXVA >> (PGSHIFT + 2*9))  // 用户地址空间占的根页表项数
+
+struct exentry {
+  uint64 insn;    // an instruction in usercopy.S that touches user memory
+  uint64 fixup;   // where to resume if it faults
+};
+
+extern struct exentry ex_table[], ex_table_end[];  // kernel.ld
+
 extern char etext[];  // kernel.ld sets this to end of kernel code.
 
 extern char trampoline[]; // trampoline.S
 
+static pte_t *walklevel(pagetable_t, uint64, int, int);
+
 // Make a direct-map page table for the kernel.
 pagetable_t
 kvmmake(void)
@@ -37,6 +55,7 @@ kvmmake(void)
   kvmmap(kpgtbl, KERNBASE, KERNBASE, (uint64)etext-KERNBASE, PTE_R | PTE_X);
 
   // map kernel data and the physical RAM we'll make use of.
+  // mappages() uses 2 MiB megapages for the aligned part.
   kvmmap(kpgtbl, (uint64)etext, (uint64)etext, PHYSTOP-(uint64)etext, PTE_R | PTE_W);
 
   // map the trampoline for trap entry/exit to
@@ -49,11 +68,33 @@ kvmmake(void)
   return kpgtbl;
 }
 
+// Count the page-table pages of pagetable, including itself.
+static int
+ptcount(pagetable_t pagetable)
+{
+  int n = 1;
+
+  for(int i = 0; i < 512; i++){
+    pte_t pte = pagetable[i];
+    if((pte & PTE_V) && (pte & (PTE_R|PTE_W|PTE_X)) == 0)
+      n += ptcount((pagetable_t)PTE2PA(pte));
+  }
+  return n;
+}
+
 // Initialize the one kernel_pagetable
 void
 kvminit(void)
 {
   kernel_pagetable = kvmmake();
+  printf("kvminit: %d page-table pages\n", ptcount(kernel_pagetable));
+
+  // 内核映射都在下半部分，各CPU只复制根页表页，下面的页表共享
+  for(int i = 0; i < NCPU; i++){
+    if((cpupagetable[i] = (pagetable_t)kalloc()) == 0)
+      panic("kvminit");
+    memmove(cpupagetable[i], kernel_pagetable, PGSIZE);
+  }
 }
 
 // Switch h/w page table register to the kernel's page table,
@@ -61,7 +102,7 @@ kvminit(void)
 void
 kvminithart()
 {
-  w_satp(MAKE_SATP(kernel_pagetable));
+  w_satp(MAKE_SATP(cpupagetable[cpuid()]));
   sfence_vma();
 }
 
@@ -77,24 +118,42 @@ kvminithart()
 //   21..29 -- 9 bits of level-1 index.
 //   12..20 -- 9 bits of level-0 index.
 //    0..11 -- 12 bits of byte offset within the page.
+//
+// If va is covered by a megapage, the level-1 leaf PTE
+// is returned instead.
 pte_t *
 walk(pagetable_t pagetable, uint64 va, int alloc)
 {
+  return walklevel(pagetable, va, alloc, 0);
+}
+
+// Like walk(), but return the PTE at the given level
+// (0 or 1), or a leaf PTE found above it.
+static pte_t *
+walklevel(pagetable_t pagetable, uint64 va, int alloc, int target)
+{
+  pagetable_t root = pagetable;
+
   if(va >= MAXVA)
     panic("walk");
 
-  for(int level = 2; level > 0; level--) {
+  for(int level = 2; level > target; level--) {
     pte_t *pte = &pagetable[PX(level, va)];
     if(*pte & PTE_V) {
+      if(*pte & (PTE_R|PTE_W|PTE_X))
+        return pte;
       pagetable = (pagetable_t)PTE2PA(*pte);
     } else {
       if(!alloc || (pagetable = (pde_t*)kalloc()) == 0)
         return 0;
       memset(pagetable, 0, PGSIZE);
       *pte = PA2PTE(pagetable) | PTE_V;
+      // 用户窗口复制的是根页表项，新填的根页表项要重新装载才看得到
+      if(level == 2)
+        uwinflush(root);
     }
   }
-  return &pagetable[PX(0, va)];
+  return &pagetable[PX(target, va)];
 }
 
 // Look up a virtual address, return the physical address,
@@ -106,14 +165,22 @@ walkaddr(pagetable_t pagetable, uint64 va)
   pte_t *pte;
   uint64 pa;
 
+  struct proc *p;
+
   if(va >= MAXVA)
     return 0;
 
   pte = walk(pagetable, va, 0);
-  if(pte == 0)
-    return 0;
-  if((*pte & PTE_V) == 0)
-    return 0;
+  if(pte == 0 || (*pte & PTE_V) == 0){
+    // copyin/copyout的目标可能是还没分配的lazy sbrk页或已换出的页；
+    // 关着中断（持有自旋锁）时不能等磁盘，只做lazy分配
+    p = myproc();
+    if(p == 0 || pagetable != p->pagetable)
+      return 0;
+    if((intr_get() ? uvmfault(pagetable, p->sz, va) : uvmlazy(pagetable, p->sz, va)) != 0)
+      return 0;
+    pte = walk(pagetable, va, 0);
+  }
   if((*pte & PTE_U) == 0)
     return 0;
   pa = PTE2PA(*pte);
@@ -134,11 +201,15 @@ kvmmap(pagetable_t kpgtbl, uint64 va, uint64 pa, uint64 sz, int perm)
 // physical addresses starting at pa. va and size might not
 // be page-aligned. Returns 0 on success, -1 if walk() couldn't
 // allocate a needed page-table page.
+// Kernel (non-PTE_U) mappings get a level-1 leaf for each
+// 2 MiB-aligned chunk; user mappings always use 4 KiB pages,
+// which the uvm functions rely on.
 int
 mappages(pagetable_t pagetable, uint64 va, uint64 size, uint64 pa, int perm)
 {
-  uint64 a, last;
+  uint64 a, last, sz;
   pte_t *pte;
+  int level;
 
   if(size == 0)
     panic("mappages: size");
@@ -146,15 +217,22 @@ mappages(pagetable_t pagetable, uint64 va, uint64 size, uint64 pa, int perm)
   a = PGROUNDDOWN(va);
   last = PGROUNDDOWN(va + size - 1);
   for(;;){
-    if((pte = walk(pagetable, a, 1)) == 0)
+    level = 0;
+    sz = PGSIZE;
+    if((perm & PTE_U) == 0 && a % MEGAPGSIZE == 0 && pa % MEGAPGSIZE == 0 &&
+       last - a >= MEGAPGSIZE - PGSIZE){
+      level = 1;
+      sz = MEGAPGSIZE;
+    }
+    if((pte = walklevel(pagetable, a, 1, level)) == 0)
       return -1;
     if(*pte & PTE_V)
       panic("mappages: remap");
     *pte = PA2PTE(pa) | perm | PTE_V;
-    if(a == last)
+    if(last - a < sz)
       break;
-    a += PGSIZE;
-    pa += PGSIZE;
+    a += sz;
+    pa += sz;
   }
   return 0;
 }
@@ -173,9 +251,15 @@ uvmunmap(pagetable_t pagetable, uint64 va, uint64 npages, int do_free)
 
   for(a = va; a < va + npages*PGSIZE; a += PGSIZE){
     if((pte = walk(pagetable, a, 0)) == 0)
-      panic("uvmunmap: walk");
+      continue;  // lazy sbrk: 从未访问过的页
+    if(*pte & PTE_SWAP){
+      if(do_free)
+        swapdrop(*pte);
+      *pte = 0;
+      continue;
+    }
     if((*pte & PTE_V) == 0)
-      panic("uvmunmap: not mapped");
+      continue;
     if(PTE_FLAGS(*pte) == PTE_V)
       panic("uvmunmap: not a leaf");
     if(do_free){
@@ -184,6 +268,7 @@ uvmunmap(pagetable_t pagetable, uint64 va, uint64 npages, int do_free)
     }
     *pte = 0;
   }
+  uwinflush(pagetable);
 }
 
 // create an empty user page table.
@@ -228,7 +313,7 @@ uvmalloc(pagetable_t pagetable, uint64 oldsz, uint64 newsz)
 
   oldsz = PGROUNDUP(oldsz);
   for(a = oldsz; a < newsz; a += PGSIZE){
-    mem = kalloc();
+    mem = uvmkalloc();
     if(mem == 0){
       uvmdealloc(pagetable, a, oldsz);
       return 0;
@@ -243,6 +328,107 @@ uvmalloc(pagetable_t pagetable, uint64 oldsz, uint64 newsz)
   return newsz;
 }
 
+// 给lazy sbrk的页分配一个清零的物理页
+static int
+lazymap(pagetable_t pagetable, uint64 va)
+{
+  char *mem;
+
+  if((mem = kalloc()) == 0)
+    return -1;
+  memset(mem, 0, PGSIZE);
+  if(mappages(pagetable, va, PGSIZE, (uint64)mem, PTE_W|PTE_X|PTE_R|PTE_U) != 0){
+    kfree(mem);
+    return -1;
+  }
+  return 0;
+}
+
+// Handle a fault on a page that sbrk reserved but never
+// allocated: map it, plus the other unmapped pages below sz
+// in its FAULTAROUND-page aligned window so that sequential
+// access does not trap on every page.
+// Returns -1 if va is not such a page or memory ran out.
+int
+uvmlazy(pagetable_t pagetable, uint64 sz, uint64 va)
+{
+  uint64 a, start, end;
+  pte_t *pte;
+
+  if(va >= sz || va >= MAXVA)
+    return -1;
+  va = PGROUNDDOWN(va);
+  // 已经映射的页（比如栈下面的保护页）或换出的页不是lazy分配能解决的
+  if((pte = walk(pagetable, va, 0)) != 0 && *pte != 0)
+    return -1;
+  if(lazymap(pagetable, va) != 0)
+    return -1;
+
+  start = va - va % (FAULTAROUND * PGSIZE);
+  end = start + FAULTAROUND * PGSIZE;
+  if(end > PGROUNDUP(sz))
+    end = PGROUNDUP(sz);
+  for(a = start; a < end; a += PGSIZE){
+    if((pte = walk(pagetable, a, 0)) != 0 && *pte != 0)
+      continue;
+    // 预取失败不影响本次缺页
+    if(lazymap(pagetable, a) != 0)
+      break;
+  }
+  return 0;
+}
+
+// Handle a page fault at va in a process of size sz, where
+// sleeping is allowed: swap the page back in, or allocate it
+// if sbrk reserved it, swapping out the current process's
+// pages while memory is short. Returns 0 if the access can
+// be retried.
+int
+uvmfault(pagetable_t pagetable, uint64 sz, uint64 va)
+{
+  struct proc *p = myproc();
+  pte_t *pte;
+
+  if(va >= sz || va >= MAXVA)
+    return -1;
+  va = PGROUNDDOWN(va);
+  if((pte = walk(pagetable, va, 0)) != 0 && (*pte & PTE_SWAP))
+    return swapin(pagetable, va);
+  if(pte != 0 && *pte != 0)
+    return -1;
+  while(uvmlazy(pagetable, sz, va) != 0)
+    if(swapout(p->pagetable, p->sz, &p->clockhand) != 0)
+      return -1;
+  return 0;
+}
+
+// Allocate a page for user memory, swapping out one of the
+// current process's pages if memory has run out. May sleep.
+void *
+uvmkalloc(void)
+{
+  struct proc *p = myproc();
+  void *mem;
+
+  while((mem = kalloc()) == 0)
+    if(p == 0 || swapout(p->pagetable, p->sz, &p->clockhand) != 0)
+      return 0;
+  return mem;
+}
+
+// Make the user pages of [va, va+len) resident, swapping them
+// in if needed. For callers that copy while holding a spinlock,
+// where copyin/copyout cannot wait for the disk: they drop the
+// lock, call this, and try again. Returns -1 on a bad address.
+int
+uvmresident(pagetable_t pagetable, uint64 va, uint64 len)
+{
+  for(uint64 a = PGROUNDDOWN(va); a < va + len; a += PGSIZE)
+    if(walkaddr(pagetable, a) == 0)
+      return -1;
+  return 0;
+}
+
 // Deallocate user pages to bring the process size from oldsz to
 // newsz.  oldsz and newsz need not be page-aligned, nor does newsz
 // need to be less than oldsz.  oldsz can be larger than the actual
@@ -306,16 +492,20 @@ uvmcopy(pagetable_t old, pagetable_t new, uint64 sz)
   char *mem;
 
   for(i = 0; i < sz; i += PGSIZE){
-    if((pte = walk(old, i, 0)) == 0)
-      panic("uvmcopy: pte should exist");
-    if((*pte & PTE_V) == 0)
-      panic("uvmcopy: page not present");
-    pa = PTE2PA(*pte);
-    flags = PTE_FLAGS(*pte);
-    if((mem = kalloc()) == 0)
+    if((pte = walk(old, i, 0)) == 0 || *pte == 0)
+      continue;  // lazy sbrk: 子进程同样等到访问时再分配
+    // 先分配再看父进程的PTE，因为分配时可能换出父进程的这一页
+    if((mem = uvmkalloc()) == 0)
       goto err;
-    memmove(mem, (char*)pa, PGSIZE);
-    if(mappages(new, i, PGSIZE, (uint64)mem, flags) != 0){
+    pte = walk(old, i, 0);
+    flags = PTE_FLAGS(*pte) & ~PTE_SWAP;
+    if(*pte & PTE_SWAP){
+      swapread(*pte, mem);
+    } else {
+      pa = PTE2PA(*pte);
+      memmove(mem, (char*)pa, PGSIZE);
+    }
+    if(mappages(new, i, PGSIZE, (uint64)mem, flags | PTE_V) != 0){
       kfree(mem);
       goto err;
     }
@@ -337,7 +527,131 @@ uvmclear(pagetable_t pagetable, uint64 va)
   pte = walk(pagetable, va, 0);
   if(pte == 0)
     panic("uvmclear");
-  *pte &= ~PTE_U;
+  // 内核经用户窗口访问时不检查PTE_U，所以连R/W也去掉，
+  // 只留X让它仍是叶子页表项；内核从不执行用户内存
+  *pte &= ~(PTE_U | PTE_R | PTE_W);
+  *pte |= PTE_X;
+}
+
+// Make this CPU's user window show pagetable's user memory.
+// Caller has interrupts off, so that the window cannot be
+// switched to another process until it is done with it.
+static void
+uwinload(pagetable_t pagetable)
+{
+  struct cpu *c = mycpu();
+  pagetable_t root = cpupagetable[cpuid()];
+
+  if(c->uwin == pagetable)
+    return;
+  for(int i = 0; i < NUWINPDE; i++)
+    root[UWINPX + i] = pagetable[i];
+  sfence_vma();
+  c->uwin = pagetable;
+}
+
+// pagetable's mappings changed; every CPU whose user window
+// shows it reloads the window (and flushes its TLB) before it
+// next uses it. The process may have run on any of them.
+void
+uwinflush(pagetable_t pagetable)
+{
+  // 同一时刻只有一个CPU在用这个页表，别的CPU最多因为看到0而多装载一次
+  for(struct cpu *c = cpus; c < &cpus[NCPU]; c++)
+    if(c->uwin == pagetable)
+      c->uwin = 0;
+}
+
+// Copy len bytes between kernel address k and the current
+// process's user address va through the user window, instead
+// of walking the page table for every page. out says which way.
+// Return 0 on success, -1 on error.
+static int
+uwincopy(uint64 va, char *k, uint64 len, int out)
+{
+  struct proc *p = myproc();
+  uint64 n, left;
+
+  if(va > p->sz || len > p->sz - va)
+    return -1;
+  while(len > 0){
+    // 每次最多拷到页尾，关中断的时间不会太长
+    n = PGSIZE - va % PGSIZE;
+    if(n > len)
+      n = len;
+    push_off();
+    uwinload(p->pagetable);
+    if(out)
+      left = copy_user((char*)(USERWIN + va), k, n);
+    else
+      left = copy_user(k, (char*)(USERWIN + va), n);
+    pop_off();
+    if(left != 0)
+      return -1;
+    len -= n;
+    k += n;
+    va += n;
+  }
+  return 0;
+}
+
+// Copy a null-terminated string of at most max bytes from the
+// current process's user address va through the user window.
+// Return 0 on success, -1 on error.
+static int
+uwinstr(char *dst, uint64 va, uint64 max)
+{
+  struct proc *p = myproc();
+  uint64 n;
+  int r;
+
+  if(va >= p->sz)
+    return -1;
+  if(max > p->sz - va)
+    max = p->sz - va;
+  while(max > 0){
+    n = PGSIZE - va % PGSIZE;
+    if(n > max)
+      n = max;
+    push_off();
+    uwinload(p->pagetable);
+    r = strncpy_user(dst, (char*)(USERWIN + va), n);
+    pop_off();
+    if(r < 0)
+      return -1;
+    if(r < n)
+      return 0;
+    max -= n;
+    dst += n;
+    va += n;
+  }
+  return -1;
+}
+
+// A page fault in kernel mode at pc, on address va. If pc is
+// listed in the fault-fixup table, either allocate the lazy
+// sbrk page and retry the instruction, or resume at its fixup
+// so that the copy fails. Returns the pc to resume at, or 0 if
+// the fault did not come from a user copy.
+uint64
+ufault(uint64 pc, uint64 va)
+{
+  struct proc *p = myproc();
+  struct exentry *e;
+
+  for(e = ex_table; e < ex_table_end; e++){
+    if(e->insn != pc)
+      continue;
+    if(p != 0 && va >= USERWIN &&
+       uvmlazy(p->pagetable, p->sz, va - USERWIN) == 0){
+      // 可能新建了根页表项，重新装载窗口
+      uwinflush(p->pagetable);
+      uwinload(p->pagetable);
+      return pc;
+    }
+    return e->fixup;
+  }
+  return 0;
 }
 
 // Copy from kernel to user.
@@ -347,6 +661,11 @@ int
 copyout(pagetable_t pagetable, uint64 dstva, char *src, uint64 len)
 {
   uint64 n, va0, pa0;
+  struct proc *p = myproc();
+
+  // 窗口拷贝失败时可能只是页被换出了，走下面的慢路径再试
+  if(p != 0 && pagetable == p->pagetable && uwincopy(dstva, src, len, 1) == 0)
+    return 0;
 
   while(len > 0){
     va0 = PGROUNDDOWN(dstva);
@@ -372,6 +691,10 @@ int
 copyin(pagetable_t pagetable, char *dst, uint64 srcva, uint64 len)
 {
   uint64 n, va0, pa0;
+  struct proc *p = myproc();
+
+  if(p != 0 && pagetable == p->pagetable && uwincopy(srcva, dst, len, 0) == 0)
+    return 0;
 
   while(len > 0){
     va0 = PGROUNDDOWN(srcva);
@@ -399,6 +722,10 @@ copyinstr(pagetable_t pagetable, char *dst, uint64 srcva, uint64 max)
 {
   uint64 n, va0, pa0;
   int got_null = 0;
+  struct proc *p = myproc();
+
+  if(p != 0 && pagetable == p->pagetable && uwinstr(dst, srcva, max) == 0)
+    return 0;
 
   while(got_null == 0 && max > 0){
     va0 = PGROUNDDOWN(srcva);
@@ -16,6 +16,7 @@
 #endif
 
 #define NINODES 200
+#define PGSIZE 4096   // kernel/riscv.h，这里不能直接include
 
 // Disk layout:
 // [ boot block | sb block | log | inode blocks | free bit map | data blocks ]
@@ -40,6 +41,7 @@ void rinode(uint inum, struct dinode *ip);
 void rsect(uint sec, void *buf);
 uint ialloc(ushort type);
 void iappend(uint inum, void *p, int n);
+void mkswapfile(uint rootino);
 void die(const char *);
 
 // convert to intel byte order
@@ -160,6 +162,9 @@ main(int argc, char *argv[])
     close(fd);
   }
 
+  if(NSWAPPAGE > 0)
+    mkswapfile(rootino);
+
   // fix size of root inode dir
   rinode(rootino, &din);
   off = xint(din.size);
@@ -238,13 +243,68 @@ balloc(int used)
   int i;
 
   printf("balloc: first %d blocks have been allocated\n", used);
-  assert(used < BSIZE*8);
-  bzero(buf, BSIZE);
-  for(i = 0; i < used; i++){
-    buf[i/8] = buf[i/8] | (0x1 << (i%8));
+  assert(used < nbitmap*BSIZE*8);
+  // 加上swapfile以后一个位图块不够了，逐块写
+  for(int b = 0; b*BSIZE*8 < used; b++){
+    bzero(buf, BSIZE);
+    for(i = b*BSIZE*8; i < used && i < (b+1)*BSIZE*8; i++){
+      buf[(i%(BSIZE*8))/8] |= (0x1 << (i%8));
+    }
+    printf("balloc: write bitmap block at sector %d\n", sb.bmapstart + b);
+    wsect(sb.bmapstart + b, buf);
   }
-  printf("balloc: write bitmap block at sector %d\n", sb.bmapstart);
-  wsect(sb.bmapstart, buf);
+}
+
+// Create /swapfile with its data on NSWAPPAGE*PGSIZE bytes of
+// contiguous blocks, so that the kernel can move a whole page
+// in one disk request. The blocks are already zero.
+void
+mkswapfile(uint rootino)
+{
+  uint inum, nblk, nl1, start, bn;
+  uint indirect[NINDIRECT], dind[NINDIRECT], l1[NINDIRECT];
+  struct dinode din;
+  struct dirent de;
+
+  nblk = NSWAPPAGE * (PGSIZE / BSIZE);
+  assert(nblk <= MAXFILE);
+  assert(nblk > NDIRECT + NINDIRECT);
+  nl1 = (nblk - NDIRECT - NINDIRECT + NINDIRECT - 1) / NINDIRECT;
+
+  inum = ialloc(T_FILE);
+  rinode(inum, &din);
+
+  // 先分配索引块，后面的数据块才能连续
+  din.addrs[NDIRECT] = xint(freeblock++);
+  din.addrs[NDIRECT+1] = xint(freeblock++);
+  bzero(dind, sizeof(dind));
+  for(uint i = 0; i < nl1; i++)
+    dind[i] = xint(freeblock++);
+  start = freeblock;
+  freeblock += nblk;
+  assert(freeblock <= FSSIZE);
+
+  bn = start;
+  for(uint i = 0; i < NDIRECT; i++)
+    din.addrs[i] = xint(bn++);
+  for(uint i = 0; i < NINDIRECT; i++)
+    indirect[i] = xint(bn++);
+  wsect(xint(din.addrs[NDIRECT]), indirect);
+  for(uint i = 0; i < nl1; i++){
+    bzero(l1, sizeof(l1));
+    for(uint j = 0; j < NINDIRECT && bn < start + nblk; j++)
+      l1[j] = xint(bn++);
+    wsect(xint(dind[i]), l1);
+  }
+  wsect(xint(din.addrs[NDIRECT+1]), dind);
+  din.size = xint(nblk * BSIZE);
+  winode(inum, &din);
+
+  bzero(&de, sizeof(de));
+  de.inum = xshort(inum);
+  strncpy(de.name, "swapfile", DIRSIZ);
+  iappend(rootino, &de, sizeof(de));
+  printf("mkswapfile: %d pages at block %u\n", NSWAPPAGE, start);
 }
 
 #define min(a, b) ((a) < (b) ? (a) : (b))
@@ -0,0 +1,56 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+#include "kernel/fcntl.h"
+#include "kernel/fs.h"
+
+// 反复读取一个能完全放进buffer cache的小文件，
+// 每次read都是内核经直接映射把缓存块拷到用户页，
+// 用来比较内核直接映射使用4KB页和2MB大页时的拷贝吞吐量。
+
+#define NBLOCK 16     // 文件块数，小于NBUF
+#define NPASS  2048   // 读整个文件的次数
+
+char buf[NBLOCK * BSIZE];
+
+int
+main(int argc, char *argv[])
+{
+  int fd, n, t0, t1, kb;
+
+  fd = open("copybench.tmp", O_CREATE | O_RDWR);
+  if(fd < 0){
+    printf("copybench: cannot create file\n");
+    exit(-1);
+  }
+  memset(buf, 'x', sizeof(buf));
+  if(write(fd, buf, sizeof(buf)) != sizeof(buf)){
+    printf("copybench: write failed\n");
+    exit(-1);
+  }
+  close(fd);
+
+  t0 = uptime();
+  for(int i = 0; i < NPASS; i++){
+    if((fd = open("copybench.tmp", O_RDONLY)) < 0){
+      printf("copybench: cannot open file\n");
+      exit(-1);
+    }
+    while((n = read(fd, buf, sizeof(buf))) > 0)
+      ;
+    close(fd);
+    if(n < 0){
+      printf("copybench: read failed\n");
+      exit(-1);
+    }
+  }
+  t1 = uptime();
+  unlink("copybench.tmp");
+
+  kb = NPASS * (int)sizeof(buf) / 1024;
+  if(t1 == t0)
+    t1 = t0 + 1;
+  // 每个tick约0.1秒
+  printf("copybench: %d KB in %d ticks, %d KB/s\n", kb, t1 - t0, kb * 10 / (t1 - t0));
+  exit(0);
+}
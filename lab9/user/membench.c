@@ -0,0 +1,82 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+// 对8B到64KB的各种长度，反复执行memmove/memset/memcmp共TOTAL字节，
+// 按uptime的tick（约0.1秒）算出MB/s。最后一列memmove的dst和src错开1字节，走逐字节的路径。
+
+#define MAXSZ (64 * 1024)
+#define TOTAL (32 * 1024 * 1024)
+
+char a[MAXSZ + 8];
+char b[MAXSZ + 8];
+
+// 在ticks内处理TOTAL字节的MB/s
+int
+rate(int ticks)
+{
+  if(ticks == 0)
+    ticks = 1;
+  return TOTAL / (1024 * 1024) * 10 / ticks;
+}
+
+int
+bench(int op, int n, int off)
+{
+  int t0, iters = TOTAL / n;
+
+  t0 = uptime();
+  for(int i = 0; i < iters; i++){
+    switch(op){
+    case 0:
+      memmove(a, b + off, n);
+      break;
+    case 1:
+      memset(a, i, n);
+      break;
+    case 2:
+      if(memcmp(a, b, n) != 0){
+        printf("membench: memcmp mismatch\n");
+        exit(-1);
+      }
+      break;
+    }
+  }
+  return rate(uptime() - t0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int mv, ms, mc, mu;
+
+  // 检查两个方向的重叠拷贝
+  for(int i = 0; i < 256; i++)
+    a[i] = i;
+  memmove(a + 3, a, 200);
+  for(int i = 0; i < 200; i++){
+    if((uchar)a[i + 3] != i){
+      printf("membench: backward memmove broken\n");
+      exit(-1);
+    }
+  }
+  memmove(a, a + 3, 200);
+  for(int i = 0; i < 200; i++){
+    if((uchar)a[i] != i){
+      printf("membench: forward memmove broken\n");
+      exit(-1);
+    }
+  }
+
+  printf("size\tmemmove\tmemset\tmemcmp\tunaligned memmove (MB/s)\n");
+  for(int n = 8; n <= MAXSZ; n *= 2){
+    mv = bench(0, n, 0);
+    ms = bench(1, n, 0);
+    memset(a, 0, n);
+    memset(b, 0, n);
+    mc = bench(2, n, 0);
+    mu = bench(0, n, 1);
+    printf("%d\t%d\t%d\t%d\t%d\n", n, mv, ms, mc, mu);
+  }
+  exit(0);
+}
@@ -3,6 +3,7 @@ struct rtcdate;
 
 // system calls
 int fork(void);
+int vfork(void);
 int exit(int) __attribute__((noreturn));
 int wait(int*);
 int pipe(int*);
@@ -28,7 +29,7 @@ int symlink(const char*, const char*);
 // ulib.c
 int stat(const char*, struct stat*);
 char* strcpy(char*, const char*);
-void *memmove(void*, const void*, int);
+void *memmove(void*, const void*, uint);
 char* strchr(const char*, char c);
 int strcmp(const char*, const char*);
 void fprintf(int, const char*, ...);
@@ -2607,6 +2607,61 @@ sbrklast(char *s)
     exit(1);
 }
 
+// allocate more memory than the machine has, so that part
+// of it must live in /swapfile, and check that every page
+// comes back intact. the pages touched first are the ones
+// that get evicted first, so reading them back pages them in.
+void
+swapthrash(char *s)
+{
+  uint64 npages = (PHYSTOP - KERNBASE) / PGSIZE + 1024;
+  char *a = sbrk(npages * PGSIZE);
+  if(a == (char*)0xffffffffffffffffL){
+    printf("%s: sbrk of %d pages failed\n", s, npages);
+    exit(1);
+  }
+  for(uint64 i = 0; i < npages; i++)
+    *(uint64*)(a + i*PGSIZE) = i;
+
+  int t0 = uptime();
+  for(uint64 i = 0; i < 1024; i++){
+    if(*(uint64*)(a + i*PGSIZE) != i){
+      printf("%s: page %d wrong after swap-in\n", s, i);
+      exit(1);
+    }
+  }
+  int t1 = uptime();
+  for(uint64 i = 0; i < npages; i++){
+    if(*(uint64*)(a + i*PGSIZE) != i){
+      printf("%s: page %d wrong\n", s, i);
+      exit(1);
+    }
+  }
+  printf("%s: 1024 page-ins in %d ticks\n", s, t1 - t0);
+
+  // 缩到放得下两份，大部分页还在交换区里，fork要把它们读进来
+  uint64 nkeep = 2048;
+  sbrk(-((npages - nkeep) * PGSIZE));
+  int pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  for(uint64 i = 0; i < nkeep; i++){
+    if(*(uint64*)(a + i*PGSIZE) != i){
+      printf("%s: page %d wrong in %s\n", s, i, pid == 0 ? "child" : "parent");
+      exit(1);
+    }
+  }
+  if(pid == 0)
+    exit(0);
+  int xstatus;
+  wait(&xstatus);
+  if(xstatus != 0)
+    exit(1);
+  sbrk(-(nkeep * PGSIZE));
+}
+
 // does sbrk handle signed int32 wrap-around with
 // negative arguments?
 void
@@ -2881,6 +2936,7 @@ main(int argc, char *argv[])
     {iref, "iref"},
     {forktest, "forktest"},
     {bigdir, "bigdir"}, // slow
+    {swapthrash, "swapthrash"}, // slow
     { 0, 0},
   };
 
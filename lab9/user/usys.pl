@@ -36,4 +36,5 @@ entry("getpid");
 entry("sbrk");
 entry("sleep");
 entry("uptime");
-entry("symlink")
\ No newline at end of file
+entry("symlink");
+entry("vfork");
\ No newline at end of file